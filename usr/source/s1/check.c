@@ -35,6 +35,7 @@ struct	inode
 #define		IFCHR	020000
 #define		IFBLK	060000
 #define	ILARG	010000
+#define	DHBASE	1792	/* first block of a directory's hashed index; as in param.h */
 
 struct
 {
@@ -361,7 +362,7 @@ struct inode *ip;
 			bread(ip->i_addr[i], buf);
 			for(j=0; j<256; j++)
 			if(buf[j] != 0)
-				chk(buf[j], "ldir", df);
+				chk(buf[j], "ldir", i*256+j<DHBASE? df: 0);
 			df =- 32;
 		}
 		return;
@@ -21,8 +21,8 @@ struct devtab; // Though devtab itself uses struct buf pointers, not vice-versa
  */
 struct buf {
 	int	b_flags;		/**< Buffer status flags (see B_ flags below). */
-	struct	buf *b_forw;	/**< Pointer to next buffer in hash queue or free list. */
-	struct	buf *b_back;	/**< Pointer to previous buffer in hash queue or free list. */
+	struct	buf *b_forw;	/**< Pointer to next buffer on its hash chain (or the NODEV chain on bfreelist). */
+	struct	buf *b_back;	/**< Pointer to previous buffer on its hash chain. */
 	struct	buf *av_forw;	/**< Pointer to next buffer in device active queue (driver's request list). */
 	struct	buf *av_back;	/**< Pointer to previous buffer in device active queue. */
 	kernel_dev_t b_dev;		/**< Device number (major and minor). */
@@ -31,7 +31,12 @@ struct buf {
 	char	*b_blkno;		/**< Block number on device (char* for PDP-11 large address space arithmetic, effectively a long). */
 	char	b_error;		/**< Error number if I/O error occurred. */
 	char	*b_resid;		/**< Remaining char count on error (or words). */
-} buf[NBUF];				/**< The array of system buffers. @see NBUF in param.h */
+	struct	buf *b_dforw;	/**< Next buffer on the dirty list (B_DELWRI only). */
+	struct	buf *b_dback;	/**< Previous buffer on the dirty list. */
+	int	b_dtime;		/**< Low word of `time` when the buffer went dirty. */
+} *buf;					/**< The array of system buffers, carved from the buffer arena by binit(). */
+
+extern int	nbuf;		/**< Number of buffers in the cache; configured in conf.c, 0 for MAXBUF.  Can only be set below MAXBUF. */
 
 /**
  * @struct devtab
@@ -52,9 +57,57 @@ struct devtab {
 	struct	buf *b_back;	/**< Unused by modern interpretation or for specific driver list linking. */
 	struct	buf *d_actf;	/**< Pointer to first buffer in device's active I/O queue. */
 	struct 	buf *d_actl;	/**< Pointer to last buffer in device's active I/O queue. */
+	int	d_qlen;			/**< Requests now queued, counted by the driver's strategy and intr routines. */
+	int	d_qmax;			/**< Largest d_qlen seen. */
+	int	d_nxfer;		/**< Transfers completed. */
 };
 
-extern struct buf bfreelist;	/**< Head of the buffer free list. */
+/**
+ * @struct bufhd
+ * @brief Head of a buffer hash chain.
+ *
+ * Laid out like the front of `struct buf` so that the head can be linked
+ * into a chain through `b_forw` and `b_back` exactly as a buffer is.
+ */
+struct bufhd {
+	int	b_flags;		/**< Unused; keeps the links at the same offsets as in `struct buf`. */
+	struct	buf *b_forw;	/**< First buffer on this chain. */
+	struct	buf *b_back;	/**< Last buffer on this chain. */
+} bufhash[NHBUF];			/**< Buffer hash chains keyed on (dev, blkno). @see NHBUF in param.h */
+
+/** @brief Hash chain head for block `blkno` of device `dev`. */
+#define	BUFHASH(dev, blkno)	(&bufhash[((dev)+(blkno)) & (NHBUF-1)])
+
+/**
+ * @struct bstat
+ * @brief Block I/O statistics, counted by bio.c.
+ */
+struct bstat {
+	int	bs_rahead;	/**< Blocks read ahead (by rastart() or as the tail of a cluster). */
+	int	bs_rahit;	/**< Read-ahead blocks later asked for through getblk(). */
+	int	bs_rawaste;	/**< Read-ahead blocks reused before anyone asked for them. */
+	int	bs_wbehind;	/**< Delayed writes started by the write-behind callout. */
+	int	bs_hit;		/**< bread/breada requests found in the cache. */
+	int	bs_miss;	/**< bread/breada requests that went to the device. */
+	int	bs_dwcoal;	/**< bdwrite calls on a buffer already awaiting a delayed write. */
+	int	bs_bwant;	/**< Sleeps in getblk on a busy buffer. */
+	int	bs_fwant;	/**< Sleeps in getblk with no free buffer. */
+	int	bs_iowait;	/**< Sleeps in iowait. */
+	int	bs_iotick;	/**< Clock ticks spent asleep in iowait. */
+} bstat;
+
+extern struct buf bfreelist;	/**< Head of the free list of B_HOT buffers, least recently used first. */
+extern struct buf bprobe;	/**< Head of the probation free list of buffers used only once. */
+extern int	nprobe;		/**< Number of buffers on bprobe. */
+extern struct buf bdirty;	/**< Head of the dirty list of B_DELWRI buffers, oldest first. */
+
+/**
+ * @brief Sort key of a queued request, in b_resid until the transfer is done.
+ *
+ * Each block driver sets it before calling disksort() and puts the
+ * residual word count back in b_resid when the transfer completes.
+ */
+#define	cylin	b_resid
 
 /** @name Buffer flags (b_flags) */
 ///@{
@@ -68,4 +121,6 @@ extern struct buf bfreelist;	/**< Head of the buffer free list. */
 #define	B_RELOC	 0200	/**< Buffer is for a relocation segment (?). */
 #define	B_ASYNC	 0400	/**< Asynchronous I/O (don't wait for completion). */
 #define	B_DELWRI 01000	/**< Delayed write (buffer is dirty, write later). */
+#define	B_RAHEAD 02000	/**< Read ahead and not yet asked for. */
+#define	B_HOT	 04000	/**< Asked for again while cached; released to bfreelist, not bprobe. */
 ///@}
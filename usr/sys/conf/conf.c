@@ -22,3 +22,4 @@ int	rootdev	{(0<<8)|0};
 int	swapdev	{(0<<8)|0};
 int	swplo	4000;
 int	nswap	872;
+int	nbuf	0;
@@ -33,6 +33,13 @@ struct tab
 	"",
 	"\t&nulldev,  &nulldev,   &mmread,   &mmwrite,   &nodev,",
 
+	"md",
+	0,	300,	BLOCK+CHAR,
+	"",
+	"",
+	"",
+	"\t&mdopen,\t&nulldev,\t&mdstrategy, \t&mdtab,",
+	"\t&mdopen,   &nulldev,   &mdread,   &mdwrite,   &nodev,",
 
 	"pc",
 	0,	70,	CHAR+INTR,
@@ -303,6 +310,7 @@ char	*strg[]
 	"int\tswapdev\t{(0<<8)|0};",
 	"int\tswplo\t4000;",
 	"int\tnswap\t872;",
+	"int\tnbuf\t0;",
 	0,
 };
 
@@ -11,21 +11,54 @@
 #include "../proc.h"
 #include "../seg.h"
 
-char	buffers[NBUF][514];
-struct	buf	swbuf;
+/*
+ * The buffer headers and their data
+ * are carved from one arena at boot.
+ * Each data area starts on a core click.
+ * The arena is kernel data, reserved
+ * for MAXBUF buffers whatever nbuf is:
+ * the buffers must lie in the kernel's
+ * own address space, so they cannot be
+ * taken from the coremap.  A smaller
+ * nbuf saves no memory, only buffers.
+ */
+#define	BALIGN	64
+#define	BSTRIDE	((514+BALIGN-1) & ~(BALIGN-1))
+
+char	bufarena[MAXBUF*(sizeof(struct buf)+BSTRIDE) + 2*BALIGN];
+struct	buf	swbuf[NSWBUF];
+int	swwant;
+struct	buf	bdirty;
+struct	buf	bprobe;
+int	nprobe;
+struct	buf	clbuf;
+char	clbuffer[NCLUST*512];
+struct	buf	*clrun[NCLUST];
+int	clnrun;
+
+#define	NMERGE	4
+struct	buf	dmbuf;
+struct	buf	*dmlist[NMERGE];
+int	dmcount;
+char	dmbuffer[NMERGE*512];
 
 struct	{ int int;};
 #define	PS	0177776
 int	tmtab;
+int	rktab;
 int	raflag	1;
+int	bwage	5;
 
 bread(dev, blkno)
 {
 	register struct buf *rbp;
 
 	rbp = getblk(dev, blkno);
-	if (rbp->b_flags&B_DONE)
+	if (rbp->b_flags&B_DONE) {
+		bstat.bs_hit++;
 		return(rbp);
+	}
+	bstat.bs_miss++;
 	rbp->b_flags =| B_READ;
 	rbp->b_wcount = -256;
 	(*bdevsw[dev.d_major].d_strategy)(rbp);
@@ -35,35 +68,51 @@ bread(dev, blkno)
 
 breada(adev, blkno, rablkno)
 {
-	register struct buf *rbp, *rabp;
+	register struct buf *rbp;
 	register int dev;
 
 	dev = adev;
 	rbp = 0;
 	if (!incore(dev, blkno)) {
 		rbp = getblk(dev, blkno);
-		if ((rbp->b_flags&B_DONE) == 0) {
+		if (rbp->b_flags&B_DONE)
+			bstat.bs_hit++;
+		else {
+			bstat.bs_miss++;
 			rbp->b_flags =| B_READ;
 			rbp->b_wcount = -256;
 			(*bdevsw[adev.d_major].d_strategy)(rbp);
 		}
 	}
-	if (rablkno && !incore(dev, rablkno) && raflag) {
-		rabp = getblk(dev, rablkno);
-		if (rabp->b_flags & B_DONE)
-			brelse(rabp);
-		else {
-			rabp->b_flags =| B_READ|B_ASYNC;
-			rabp->b_wcount = -256;
-			(*bdevsw[adev.d_major].d_strategy)(rabp);
-		}
-	}
+	if (rablkno)
+		rastart(dev, rablkno);
 	if (rbp==0)
 		return(bread(dev, blkno));
 	iowait(rbp);
 	return(rbp);
 }
 
+/*
+ * Start an asynchronous read
+ * of rablkno unless it is cached.
+ */
+rastart(dev, rablkno)
+{
+	register struct buf *rabp;
+
+	if (!raflag || incore(dev, rablkno))
+		return;
+	rabp = getblk(dev, rablkno);
+	if (rabp->b_flags & B_DONE)
+		brelse(rabp);
+	else {
+		rabp->b_flags =| B_READ|B_ASYNC|B_RAHEAD;
+		rabp->b_wcount = -256;
+		bstat.bs_rahead++;
+		(*bdevsw[dev.d_major].d_strategy)(rabp);
+	}
+}
+
 bwrite(bp)
 struct buf *bp;
 {
@@ -72,6 +121,8 @@ struct buf *bp;
 
 	rbp = bp;
 	flag = rbp->b_flags;
+	if (flag&B_DELWRI)
+		bdunlink(rbp);
 	rbp->b_flags =& ~(B_READ | B_DONE | B_ERROR | B_DELWRI);
 	rbp->b_wcount = -256;
 	(*bdevsw[rbp->b_dev.d_major].d_strategy)(rbp);
@@ -91,11 +142,50 @@ struct buf *bp;
 	if (bdevsw[rbp->b_dev.d_major].d_tab == &tmtab)
 		bawrite(rbp);
 	else {
+		if (rbp->b_flags&B_DELWRI)
+			bstat.bs_dwcoal++;
+		else
+			bdlink(rbp);
 		rbp->b_flags =| B_DELWRI | B_DONE;
 		brelse(rbp);
 	}
 }
 
+/*
+ * The dirty list holds the delayed-write
+ * buffers in the order they were dirtied.
+ */
+bdlink(bp)
+struct buf *bp;
+{
+	register struct buf *rbp;
+	register int sps;
+
+	rbp = bp;
+	sps = PS->int;
+	spl6();
+	rbp->b_dtime = time[1];
+	rbp->b_dback = bdirty.b_dback;
+	rbp->b_dforw = &bdirty;
+	bdirty.b_dback->b_dforw = rbp;
+	bdirty.b_dback = rbp;
+	PS->int = sps;
+}
+
+bdunlink(bp)
+struct buf *bp;
+{
+	register struct buf *rbp;
+	register int sps;
+
+	rbp = bp;
+	sps = PS->int;
+	spl6();
+	rbp->b_dback->b_dforw = rbp->b_dforw;
+	rbp->b_dforw->b_dback = rbp->b_dback;
+	PS->int = sps;
+}
+
 bawrite(bp)
 struct buf *bp;
 {
@@ -106,10 +196,20 @@ struct buf *bp;
 	bwrite(rbp);
 }
 
+/*
+ * Release a buffer to the free lists.
+ * The cache keeps two: a buffer that has been
+ * asked for only once goes to the tail of bprobe;
+ * one found again by getblk is B_HOT and goes to
+ * the tail of bfreelist.  Victims come from bprobe
+ * while it holds more than a quarter of the cache,
+ * so a long sequential pass recycles its own buffers
+ * and leaves the hot ones alone.
+ */
 brelse(bp)
 struct buf *bp;
 {
-	register struct buf *rbp, **backp;
+	register struct buf *rbp, *dp;
 	register int sps;
 
 	rbp = bp;
@@ -119,16 +219,30 @@ struct buf *bp;
 		bfreelist.b_flags =& ~B_WANTED;
 		wakeup(&bfreelist);
 	}
-	if (rbp->b_flags&B_ERROR)
-		rbp->b_dev.d_minor = -1;  /* no assoc. on error */
-	backp = &bfreelist.av_back;
 	sps = PS->int;
 	spl6();
+	if (rbp->b_flags&B_ERROR) {
+		rbp->b_dev.d_minor = -1;  /* no assoc. on error */
+		rbp->b_flags =& ~(B_WANTED|B_BUSY|B_ASYNC|B_HOT);
+		rbp->av_forw = bprobe.av_forw;
+		rbp->av_back = &bprobe;
+		bprobe.av_forw->av_back = rbp;
+		bprobe.av_forw = rbp;
+		nprobe++;
+		PS->int = sps;
+		return;
+	}
+	if (rbp->b_flags&B_HOT)
+		dp = &bfreelist;
+	else {
+		dp = &bprobe;
+		nprobe++;
+	}
 	rbp->b_flags =& ~(B_WANTED|B_BUSY|B_ASYNC);
-	(*backp)->av_forw = rbp;
-	rbp->av_back = *backp;
-	*backp = rbp;
-	rbp->av_forw = &bfreelist;
+	rbp->av_forw = dp;
+	rbp->av_back = dp->av_back;
+	dp->av_back->av_forw = rbp;
+	dp->av_back = rbp;
 	PS->int = sps;
 }
 
@@ -136,10 +250,10 @@ incore(adev, blkno)
 {
 	register int dev;
 	register struct buf *bp;
-	register struct devtab *dp;
+	register struct bufhd *dp;
 
 	dev = adev;
-	dp = bdevsw[adev.d_major].d_tab;
+	dp = BUFHASH(dev, blkno);
 	for (bp=dp->b_forw; bp != dp; bp = bp->b_forw)
 		if (bp->b_blkno==blkno && bp->b_dev==dev)
 			return(bp);
@@ -149,7 +263,7 @@ incore(adev, blkno)
 getblk(dev, blkno)
 {
 	register struct buf *bp;
-	register struct devtab *dp;
+	register struct bufhd *dp;
 	extern lbolt;
 
 	if(dev.d_major >= nblkdev)
@@ -159,36 +273,49 @@ getblk(dev, blkno)
 	if (dev < 0)
 		dp = &bfreelist;
 	else {
-		dp = bdevsw[dev.d_major].d_tab;
+		dp = BUFHASH(dev, blkno);
 		for (bp=dp->b_forw; bp != dp; bp = bp->b_forw) {
 			if (bp->b_blkno!=blkno || bp->b_dev!=dev)
 				continue;
 			spl6();
 			if (bp->b_flags&B_BUSY) {
 				bp->b_flags =| B_WANTED;
+				bstat.bs_bwant++;
 				sleep(bp, PRIBIO);
 				spl0();
 				goto loop;
 			}
 			spl0();
 			notavail(bp);
+			if (bp->b_flags&B_RAHEAD) {
+				bp->b_flags =& ~B_RAHEAD;
+				bstat.bs_rahit++;
+			} else
+				bp->b_flags =| B_HOT;
 			return(bp);
 		}
 	}
 	spl6();
-	if (bfreelist.av_forw == &bfreelist) {
+	if (nprobe > (nbuf>>2) || bfreelist.av_forw == &bfreelist)
+		bp = bprobe.av_forw;
+	else
+		bp = bfreelist.av_forw;
+	if (bp == &bprobe) {
 		bfreelist.b_flags =| B_WANTED;
+		bstat.bs_fwant++;
 		sleep(&bfreelist, PRIBIO);
 		spl0();
 		goto loop;
 	}
 	spl0();
-	notavail(bp = bfreelist.av_forw);
+	notavail(bp);
 	if (bp->b_flags & B_DELWRI) {
 		bp->b_flags =| B_ASYNC;
 		bwrite(bp);
 		goto loop;
 	}
+	if (bp->b_flags & B_RAHEAD)
+		bstat.bs_rawaste++;
 	bp->b_flags = B_BUSY | B_RELOC;
 	bp->b_back->b_forw = bp->b_forw;
 	bp->b_forw->b_back = bp->b_back;
@@ -205,11 +332,18 @@ iowait(bp)
 struct buf *bp;
 {
 	register struct buf *rbp;
+	register int t;
+	extern lbolt;
 
 	rbp = bp;
 	spl6();
-	while ((rbp->b_flags&B_DONE)==0)
-		sleep(rbp, PRIBIO);
+	if ((rbp->b_flags&B_DONE)==0) {
+		bstat.bs_iowait++;
+		t = time[1]*60 + lbolt;
+		while ((rbp->b_flags&B_DONE)==0)
+			sleep(rbp, PRIBIO);
+		bstat.bs_iotick =+ time[1]*60 + lbolt - t;
+	}
 	spl0();
 	geterror(rbp);
 }
@@ -225,6 +359,8 @@ struct buf *bp;
 	spl6();
 	rbp->av_back->av_forw = rbp->av_forw;
 	rbp->av_forw->av_back = rbp->av_back;
+	if ((rbp->b_flags&B_HOT) == 0)
+		nprobe--;
 	rbp->b_flags =| B_BUSY;
 	PS->int = sps;
 }
@@ -236,7 +372,9 @@ struct buf *bp;
 
 	rbp = bp;
 	rbp->b_flags =| B_DONE;
-	if (rbp->b_flags&B_ASYNC)
+	if (rbp == &clbuf && rbp->b_flags&B_ASYNC)
+		cldone();
+	else if (rbp->b_flags&B_ASYNC)
 		brelse(rbp);
 	else {
 		rbp->b_flags =& ~B_WANTED;
@@ -257,19 +395,36 @@ int *bp;
 	while (--c);
 }
 
+/*
+ * Size the cache from nbuf, MAXBUF if
+ * that is 0 or too big, and lay it out
+ * in bufarena.
+ */
 binit()
 {
 	register struct buf *bp;
-	register struct devtab *dp;
-	register int i;
+	register struct bufhd *dp;
+	register char *cp;
+	int i;
 	struct bdevsw *bdp;
+	int bwflush();
 
+	if (nbuf <= 0 || nbuf > MAXBUF)
+		nbuf = MAXBUF;
+	cp = (bufarena+BALIGN-1) & ~(BALIGN-1);
+	buf = cp;
+	cp =+ (nbuf*sizeof(struct buf) + BALIGN-1) & ~(BALIGN-1);
 	bfreelist.b_forw = bfreelist.b_back =
 	    bfreelist.av_forw = bfreelist.av_back = &bfreelist;
-	for (i=0; i<NBUF; i++) {
+	bprobe.av_forw = bprobe.av_back = &bprobe;
+	for (dp = bufhash; dp < &bufhash[NHBUF]; dp++)
+		dp->b_forw = dp->b_back = dp;
+	bdirty.b_dforw = bdirty.b_dback = &bdirty;
+	for (i=0; i<nbuf; i++) {
 		bp = &buf[i];
 		bp->b_dev = -1;
-		bp->b_addr = buffers[i];
+		bp->b_addr = cp;
+		cp =+ BSTRIDE;
 		bp->b_back = &bfreelist;
 		bp->b_forw = bfreelist.b_forw;
 		bfreelist.b_forw->b_back = bp;
@@ -278,13 +433,168 @@ binit()
 		brelse(bp);
 	}
 	i = 0;
-	for (bdp = bdevsw; bdp->d_open; bdp++) {
-		dp = bdp->d_tab;
-		dp->b_forw = dp;
-		dp->b_back = dp;
+	for (bdp = bdevsw; bdp->d_open; bdp++)
 		i++;
-	}
 	nblkdev = i;
+	printf("buf = %d\n", nbuf);
+	timeout(bwflush, 0, 60);
+}
+
+/*
+ * Put bp on the device queue dp in
+ * one-way elevator order by cylin.
+ * The queue holds the request in
+ * progress, then those at or beyond its
+ * cylinder in increasing order, then
+ * those before it, also increasing,
+ * to be done on the next sweep.
+ */
+disksort(dp, bp)
+struct devtab *dp;
+struct buf *bp;
+{
+	register struct buf *ap, *rbp;
+
+	rbp = bp;
+	rbp->av_forw = 0;
+	if ((ap = dp->d_actf) == 0) {
+		dp->d_actf = rbp;
+		dp->d_actl = rbp;
+		return;
+	}
+	if (rbp->cylin < ap->cylin) {
+		for (; ap->av_forw; ap = ap->av_forw)
+			if (ap->av_forw->cylin < ap->cylin) {
+				if (dsbefore(rbp, ap->av_forw))
+					goto insert;
+				ap = ap->av_forw;
+				break;
+			}
+	}
+	for (; ap->av_forw; ap = ap->av_forw)
+		if (ap->av_forw->cylin < ap->cylin ||
+		    dsbefore(rbp, ap->av_forw))
+			break;
+insert:
+	rbp->av_forw = ap->av_forw;
+	ap->av_forw = rbp;
+	if (ap == dp->d_actl)
+		dp->d_actl = rbp;
+}
+
+/*
+ * Does request a go before b on a sweep?
+ * Within a cylinder, lower blocks first,
+ * so adjacent blocks end up next to each
+ * other for dmerge.
+ */
+dsbefore(a, b)
+struct buf *a, *b;
+{
+
+	if (a->cylin != b->cylin)
+		return(a->cylin < b->cylin);
+	return(a->b_blkno < b->b_blkno);
+}
+
+/*
+ * Called by a disk start routine with
+ * bp at the head of queue dp.  The single-block
+ * cache buffers queued right behind bp for the
+ * following blocks of the same device, in the
+ * same direction, are taken off the queue and
+ * joined with bp into one transfer through
+ * dmbuf; the buffer to hand to devstart is
+ * returned.  devdone undoes it when the
+ * transfer is over.  Restarting the same bp
+ * after an error gets the same dmbuf back.
+ */
+dmerge(dp, bp)
+struct devtab *dp;
+struct buf *bp;
+{
+	register struct buf *ap, *np;
+	register int n;
+	char *p;
+
+	if (dmbuf.b_flags&B_BUSY)
+		return(dmlist[0]==bp? &dmbuf: bp);
+	if (!dmok(bp))
+		return(bp);
+	ap = bp;
+	for (n=1; n<NMERGE; n++) {
+		np = ap->av_forw;
+		if (np==0 || !dmok(np) || np->b_dev!=bp->b_dev ||
+		    np->b_blkno!=ap->b_blkno+1 ||
+		    (np->b_flags^bp->b_flags)&B_READ)
+			break;
+		dmlist[n] = np;
+		ap = np;
+	}
+	if (n == 1)
+		return(bp);
+	dmlist[0] = bp;
+	dmcount = n;
+	bp->av_forw = ap->av_forw;
+	if (dp->d_actl == ap)
+		dp->d_actl = bp;
+	dp->d_qlen =- n-1;
+	dmbuf.b_flags = B_BUSY | bp->b_flags&B_READ;
+	dmbuf.b_dev = bp->b_dev;
+	dmbuf.b_blkno = bp->b_blkno;
+	dmbuf.b_addr = dmbuffer;
+	dmbuf.b_wcount = -256*n;
+	if ((bp->b_flags&B_READ) == 0)
+		for (n=0, p=dmbuffer; n<dmcount; n++, p =+ 512)
+			bcopy(dmlist[n]->b_addr, p, 256);
+	return(&dmbuf);
+}
+
+/*
+ * Only whole blocks in cache buffers,
+ * which are always in kernel space.
+ * The header itself is checked: raw
+ * and swap headers may point anywhere.
+ */
+dmok(bp)
+struct buf *bp;
+{
+	register struct buf *rbp;
+
+	rbp = bp;
+	return(rbp >= buf && rbp < &buf[nbuf] &&
+	    (rbp->b_flags&B_XMEM) == 0 && rbp->b_wcount == -256);
+}
+
+/*
+ * Called from a disk interrupt routine
+ * in place of iodone when bp is finished.
+ * If it led a merged transfer, the other
+ * buffers are given their data and status
+ * and finished as well.
+ */
+devdone(bp)
+struct buf *bp;
+{
+	register struct buf *rbp, *np;
+	register int n;
+
+	rbp = bp;
+	if ((dmbuf.b_flags&B_BUSY) && dmlist[0] == rbp) {
+		for (n=0; n<dmcount; n++) {
+			np = dmlist[n];
+			if (rbp->b_flags&B_ERROR)
+				np->b_flags =| B_ERROR;
+			else if (np->b_flags&B_READ)
+				bcopy(dmbuffer+512*n, np->b_addr, 256);
+			if (n != 0) {
+				np->b_resid = 0;
+				iodone(np);
+			}
+		}
+		dmbuf.b_flags = 0;
+	}
+	iodone(rbp);
 }
 
 /*
@@ -315,57 +625,316 @@ int *devloc;
 	*--dp = com;
 }
 
+/*
+ * Clustered I/O.
+ * A run of blocks that lie next to each
+ * other on the device is moved in one
+ * transfer through clbuffer and split
+ * into (or gathered from) cache buffers.
+ */
+bclread(adev, blkno, an)
+{
+	register struct buf *bp;
+	register int dev, n;
+	int i;
+
+	dev = adev;
+	if (!bclok(dev))
+		return(bread(dev, blkno));
+	n = min(an, NCLUST);
+	for (i=1; i<n; i++)
+		if (incore(dev, blkno+i))
+			break;
+	n = i;
+	if (n <= 1 || incore(dev, blkno))
+		return(bread(dev, blkno));
+	clget();
+	clio(dev, blkno, n, B_READ);
+	if (clbuf.b_flags&B_ERROR) {
+		clfree();
+		return(bread(dev, blkno));
+	}
+	bstat.bs_miss++;
+	for (i=n-1; i>=0; i--) {
+		bp = getblk(dev, blkno+i);
+		if ((bp->b_flags&B_DONE) == 0) {
+			bcopy(clbuffer+512*i, bp->b_addr, 256);
+			bp->b_flags =| B_DONE;
+			if (i != 0) {
+				bp->b_flags =| B_RAHEAD;
+				bstat.bs_rahead++;
+			}
+		}
+		if (i != 0)
+			brelse(bp);
+	}
+	clfree();
+	return(bp);
+}
+
+/*
+ * Write in one transfer the run of
+ * delayed-write blocks on dev that
+ * ends at blkno.  A block that is not
+ * in the cache, busy or clean ends it.
+ * The transfer is started and left to
+ * finish at interrupt level (cldone),
+ * as bawrite would leave each block.
+ */
+bclwrite(adev, blkno)
+{
+	register struct buf *bp;
+	register int dev, n;
+	int i;
+
+	dev = adev;
+	if (!bclok(dev))
+		return;
+	clget();
+	for (n=0; n<NCLUST; n++) {
+		bp = incore(dev, blkno-n);
+		spl6();
+		if (bp==0 || (bp->b_flags&(B_BUSY|B_DELWRI)) != B_DELWRI) {
+			spl0();
+			break;
+		}
+		notavail(bp);
+		spl0();
+		clrun[n] = bp;
+	}
+	if (n <= 1) {
+		clfree();
+		if (n)
+			bawrite(clrun[0]);
+		return;
+	}
+	for (i=0; i<n; i++)
+		bcopy(clrun[i]->b_addr, clbuffer+512*(n-1-i), 256);
+	clnrun = n;
+	clio(dev, blkno-n+1, n, B_WRITE|B_ASYNC);
+}
+
+/*
+ * Finish an asynchronous cluster write:
+ * give each buffer of the run its status
+ * and release it, then release clbuf.
+ */
+cldone()
+{
+	register struct buf *bp;
+	register int i;
+
+	for (i=0; i<clnrun; i++) {
+		bp = clrun[i];
+		bdunlink(bp);
+		bp->b_flags =& ~(B_DELWRI|B_ERROR);
+		if (clbuf.b_flags&B_ERROR) {
+			bp->b_flags =| B_ERROR;
+			bp->b_error = clbuf.b_error;
+		}
+		brelse(bp);
+	}
+	clnrun = 0;
+	clfree();
+}
+
+/*
+ * Can a transfer on dev cover more than
+ * one block?  Not on tape, where each
+ * block is a record, nor on the
+ * interleaved rk minors (8 and up),
+ * where rkaddr maps only the first block
+ * of a request to its drive and sector.
+ */
+bclok(dev)
+{
+	register int *dp;
+
+	dp = bdevsw[dev.d_major].d_tab;
+	if (dp == &tmtab)
+		return(0);
+	if (dp == &rktab && dev.d_minor >= 8)
+		return(0);
+	return(1);
+}
+
+clget()
+{
+
+	spl6();
+	while (clbuf.b_flags&B_BUSY) {
+		clbuf.b_flags =| B_WANTED;
+		sleep(&clbuf, PRIBIO);
+	}
+	clbuf.b_flags = B_BUSY;
+	spl0();
+}
+
+clfree()
+{
+
+	if (clbuf.b_flags&B_WANTED)
+		wakeup(&clbuf);
+	clbuf.b_flags = 0;
+}
+
+/*
+ * Move n blocks starting at blkno on dev
+ * between the device and clbuffer.
+ * The caller holds clbuf.  With B_ASYNC
+ * the transfer is only started; cldone
+ * finishes it.
+ */
+clio(dev, blkno, n, rw)
+{
+
+	clbuf.b_flags = B_BUSY | rw;
+	clbuf.b_dev = dev;
+	clbuf.b_blkno = blkno;
+	clbuf.b_addr = clbuffer;
+	clbuf.b_wcount = -256*n;
+	clbuf.b_error = 0;
+	(*bdevsw[dev.d_major].d_strategy)(&clbuf);
+	if (rw&B_ASYNC)
+		return;
+	spl6();
+	while ((clbuf.b_flags&B_DONE) == 0)
+		sleep(&clbuf, PRIBIO);
+	spl0();
+}
+
 /*
  * swap I/O
  */
 swap(blkno, coreaddr, count, rdflg)
 {
-	register int *fp;
 
-	fp = &swbuf.b_flags;
+	return(swwait(swstart(blkno, coreaddr, count, rdflg)));
+}
+
+/*
+ * Start a swap transfer in one of
+ * the NSWBUF swap buffers and return
+ * the buffer without waiting for it,
+ * so several can be queued at once.
+ */
+swstart(blkno, coreaddr, count, rdflg)
+{
+	register struct buf *bp;
+
 	spl6();
-	while (*fp&B_BUSY) {
-		*fp =| B_WANTED;
-		sleep(fp, PSWP);
-	}
-	*fp = B_BUSY | rdflg | (coreaddr>>6)&B_XMEM;
-	swbuf.b_dev = swapdev;
-	swbuf.b_wcount = - (count<<5);	/* 32 w/block */
-	swbuf.b_blkno = blkno;
-	swbuf.b_addr = coreaddr<<6;	/* 64 b/block */
-	(*bdevsw[swapdev>>8].d_strategy)(&swbuf);
+loop:
+	for (bp = swbuf; bp < &swbuf[NSWBUF]; bp++)
+		if ((bp->b_flags&B_BUSY) == 0)
+			goto found;
+	swwant++;
+	sleep(&swwant, PSWP);
+	goto loop;
+
+found:
+	bp->b_flags = B_BUSY | rdflg | (coreaddr>>6)&B_XMEM;
+	bp->b_dev = swapdev;
+	bp->b_wcount = - (count<<5);	/* 32 w/block */
+	bp->b_blkno = blkno;
+	bp->b_addr = coreaddr<<6;	/* 64 b/block */
+	(*bdevsw[swapdev>>8].d_strategy)(bp);
+	spl0();
+	return(bp);
+}
+
+/*
+ * Wait for a transfer begun by swstart,
+ * free its buffer and return the error bit.
+ */
+swwait(bp)
+struct buf *bp;
+{
+	register struct buf *rbp;
+	register int e;
+
+	rbp = bp;
 	spl6();
-	while((*fp&B_DONE)==0)
-		sleep(fp, PSWP);
-	if (*fp&B_WANTED)
-		wakeup(fp);
+	while((rbp->b_flags&B_DONE)==0)
+		sleep(rbp, PSWP);
+	e = rbp->b_flags&B_ERROR;
+	rbp->b_flags = 0;
+	if (swwant) {
+		swwant = 0;
+		wakeup(&swwant);
+	}
 	spl0();
-	*fp =& ~(B_BUSY|B_WANTED);
-	return(*fp&B_ERROR);
+	return(e);
 }
 
 /*
  * make sure all write-behind blocks
  * on dev (or NODEV for all)
  * are flushed out.
+ * The disk strategy routines return
+ * at the priority they were called at,
+ * so the list holds still at spl6.
  */
 bflush(dev)
 {
-	register struct buf *bp;
+	register struct buf *bp, *nbp;
 
-loop:
 	spl6();
-	for (bp = bfreelist.av_forw; bp != &bfreelist; bp = bp->av_forw) {
-		if (bp->b_flags&B_DELWRI && (dev == NODEV||dev==bp->b_dev)) {
+	for (bp = bdirty.b_dforw; bp != &bdirty; bp = nbp) {
+		nbp = bp->b_dforw;
+		if ((bp->b_flags&B_BUSY)==0 && (dev == NODEV||dev==bp->b_dev)) {
 			bp->b_flags =| B_ASYNC;
 			notavail(bp);
 			bwrite(bp);
-			goto loop;
 		}
 	}
 	spl0();
 }
 
+/*
+ * Write-behind, called once a second
+ * from the callout table.  Of the buffers
+ * dirty for bwage seconds or more, up to
+ * NWBEHIND that are not busy are started,
+ * sorted by device and block number.
+ */
+#define	NWBEHIND	8
+
+bwflush()
+{
+	register struct buf *bp, *np;
+	register int n;
+	int i, sps;
+	struct buf *wb[NWBEHIND];
+
+	sps = PS->int;
+	spl6();
+	n = 0;
+	for (bp = bdirty.b_dforw; bp != &bdirty && n < NWBEHIND; bp = bp->b_dforw) {
+		if (time[1] - bp->b_dtime < bwage)
+			break;
+		if (bp->b_flags&B_BUSY)
+			continue;
+		for (i=n; i>0; i--) {
+			np = wb[i-1];
+			if (np->b_dev < bp->b_dev ||
+			    np->b_dev == bp->b_dev && np->b_blkno <= bp->b_blkno)
+				break;
+			wb[i] = np;
+		}
+		wb[i] = bp;
+		n++;
+	}
+	for (i=0; i<n; i++) {
+		bp = wb[i];
+		bp->b_flags =| B_ASYNC;
+		notavail(bp);
+		bwrite(bp);
+	}
+	bstat.bs_wbehind =+ n;
+	PS->int = sps;
+	timeout(bwflush, 0, 60);
+}
+
 physio(strat, abp, dev, rw)
 struct buf *abp;
 int (*strat)();
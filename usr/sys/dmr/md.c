@@ -0,0 +1,138 @@
+#
+/*
+ * Memory disk driver.
+ * mdsize blocks of core, taken from
+ * the coremap at the first open, serve as
+ * a disk with no controller, so the
+ * buffer cache and file system can be
+ * driven and timed on any machine.
+ * If mdlat is set, each transfer is
+ * held that many clock ticks before
+ * it completes, as a disk would be.
+ */
+
+#include "../param.h"
+#include "../buf.h"
+#include "../conf.h"
+#include "../systm.h"
+#include "../user.h"
+
+struct { int integ; };
+
+#define	PS	0177776
+
+struct	devtab	mdtab;
+struct	buf	rmdbuf;
+
+int	mdsize	256;		/* blocks */
+int	mdlat	0;		/* ticks per transfer */
+int	mdaddr;			/* core address of block 0, in clicks */
+
+/*
+ * The core is taken here, in the
+ * opening process, and never in
+ * mdstrategy, which may be called
+ * at interrupt level.
+ */
+mdopen(dev, flag)
+{
+
+	if (mdaddr == 0 && (mdaddr = malloc(coremap, mdsize<<3)) == 0)
+		u.u_error = ENXIO;
+}
+
+mdstrategy(abp)
+struct buf *abp;
+{
+	register struct buf *bp;
+	int s;
+
+	bp = abp;
+	if (mdaddr == 0 || bp->b_addr&077 || bp->b_wcount&037 ||
+	    bp->b_blkno + ((((-bp->b_wcount)>>5)+7)>>3) > mdsize) {
+		bp->b_flags =| B_ERROR;
+		iodone(bp);
+		return;
+	}
+	bp->cylin = bp->b_blkno;
+	s = PS->integ;
+	spl5();
+	if (++mdtab.d_qlen > mdtab.d_qmax)
+		mdtab.d_qmax = mdtab.d_qlen;
+	disksort(&mdtab, bp);
+	if (mdtab.d_active==0)
+		mdstart();
+	PS->integ = s;
+}
+
+/*
+ * Run the queue.  With no latency
+ * every transfer is done at once;
+ * otherwise the head is finished
+ * by mdintr from the callout table.
+ */
+mdstart()
+{
+
+	while (mdtab.d_actf) {
+		if (mdlat > 0) {
+			mdtab.d_active++;
+			timeout(mdintr, 0, mdlat);
+			return;
+		}
+		mdxfer();
+	}
+}
+
+mdintr()
+{
+	register int s;
+
+	s = PS->integ;
+	spl5();
+	mdtab.d_active = 0;
+	mdxfer();
+	mdstart();
+	PS->integ = s;
+}
+
+/*
+ * Copy the head of the queue a click
+ * at a time between the disk's core
+ * and the buffer and finish it.
+ */
+mdxfer()
+{
+	register struct buf *bp;
+	register int a, d;
+	int n;
+
+	bp = mdtab.d_actf;
+	mdtab.d_actf = bp->av_forw;
+	mdtab.d_qlen--;
+	mdtab.d_nxfer++;
+	d = mdaddr + (bp->b_blkno<<3);
+	a = ((bp->b_flags&B_XMEM)<<6) | (bp->b_addr>>6)&01777;
+	for (n = (-bp->b_wcount)>>5; n > 0; n--) {
+		if (bp->b_flags&B_READ)
+			copyseg(d, a);
+		else
+			copyseg(a, d);
+		a++;
+		d++;
+	}
+	bp->b_resid = 0;
+	iodone(bp);
+}
+
+mdread(dev)
+{
+
+	physio(mdstrategy, &rmdbuf, dev, B_READ);
+}
+
+mdwrite(dev)
+{
+
+	physio(mdstrategy, &rmdbuf, dev, B_WRITE);
+}
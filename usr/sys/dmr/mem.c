@@ -8,13 +8,27 @@
  *	minor device 0 is physical memory
  *	minor device 1 is kernel memory
  *	minor device 2 is EOF/RATHOLE
+ *	minor device 3 is the block I/O statistics:
+ *	struct bstat, then d_qlen, d_qmax and d_nxfer
+ *	for each of the first NSDEV block devices
+ *	minor device 4 is the name cache statistics,
+ *	struct ncstat
+ *	minor device 5 is the inode writeback statistics,
+ *	struct iustat
+ *	minor device 6 is the wakeup statistics,
+ *	struct wkstat
  */
 
 #include "../param.h"
 #include "../user.h"
+#include "../buf.h"
+#include "../inode.h"
+#include "../proc.h"
 #include "../conf.h"
 #include "../seg.h"
 
+#define	NSDEV	8
+
 mmread(dev)
 {
 	register c, bn, on;
@@ -22,6 +36,22 @@ mmread(dev)
 
 	if(dev.d_minor == 2)
 		return;
+	if(dev.d_minor == 3) {
+		mmstat();
+		return;
+	}
+	if(dev.d_minor == 4) {
+		mmcopy(&ncstat, sizeof ncstat);
+		return;
+	}
+	if(dev.d_minor == 5) {
+		mmcopy(&iustat, sizeof iustat);
+		return;
+	}
+	if(dev.d_minor == 6) {
+		mmcopy(&wkstat, sizeof wkstat);
+		return;
+	}
 	do {
 		bn = lshift(u.u_offset, -6);
 		on = u.u_offset[1] & 077;
@@ -41,7 +71,7 @@ mmwrite(dev)
 	register c, bn, on;
 	int a;
 
-	if(dev.d_minor == 2) {
+	if(dev.d_minor >= 2) {
 		c = u.u_count;
 		u.u_count = 0;
 		u.u_base =+ c;
@@ -63,3 +93,51 @@ mmwrite(dev)
 		spl0();
 	}
 }
+
+/*
+ * Take a snapshot of the statistics
+ * and pass the caller's part of it.
+ */
+mmstat()
+{
+	register int *ip, *dp;
+	register i;
+	int st[sizeof bstat/2 + 3*NSDEV];
+	extern tmtab;
+
+	ip = st;
+	dp = &bstat;
+	for(i=0; i<sizeof bstat/2; i++)
+		*ip++ = *dp++;
+	for(i=0; i<NSDEV; i++) {
+		dp = 0;
+		if(i < nblkdev)
+			dp = bdevsw[i].d_tab;
+		if(dp == 0 || dp == &tmtab) {
+			*ip++ = 0;
+			*ip++ = 0;
+			*ip++ = 0;
+			continue;
+		}
+		*ip++ = dp->d_qlen;
+		*ip++ = dp->d_qmax;
+		*ip++ = dp->d_nxfer;
+	}
+	mmcopy(st, sizeof st);
+}
+
+/*
+ * Pass bytes of the n-byte kernel
+ * table at p from the current offset.
+ */
+mmcopy(p, n)
+char *p;
+{
+	register char *cp;
+
+	if(u.u_offset[0] != 0 || u.u_offset[1] < 0)
+		return;
+	cp = p + u.u_offset[1];
+	while(u.u_offset[1] < n && passc(*cp++) >= 0)
+		;
+}
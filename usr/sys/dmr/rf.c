@@ -19,12 +19,14 @@ struct {
 	int	rfda;
 	int	rfdae;
 };
+struct { int integ; };
 
 struct	devtab	rftab;
 struct	buf	rrfbuf;
 
 #define	NRFBLK	1024
 #define	RFADDR	0177460
+#define	PS	0177776
 
 #define	GO	01
 #define	RCOM	02
@@ -35,6 +37,7 @@ rfstrategy(abp)
 struct buf *abp;
 {
 	register struct buf *bp;
+	int s;
 
 	bp = abp;
 	if (bp->b_blkno >= NRFBLK*(bp->b_dev.d_minor+1)) {
@@ -42,16 +45,15 @@ struct buf *abp;
 		iodone(bp);
 		return;
 	}
-	bp->av_forw = 0;
+	bp->cylin = bp->b_blkno;
+	s = PS->integ;
 	spl5();
-	if (rftab.d_actf==0)
-		rftab.d_actf = bp;
-	else
-		rftab.d_actl->av_forw = bp;
-	rftab.d_actl = bp;
+	if (++rftab.d_qlen > rftab.d_qmax)
+		rftab.d_qmax = rftab.d_qlen;
+	disksort(&rftab, bp);
 	if (rftab.d_active==0)
 		rfstart();
-	spl0();
+	PS->integ = s;
 }
 
 rfstart()
@@ -83,6 +85,9 @@ rfintr()
 	}
 	rftab.d_errcnt = 0;
 	rftab.d_actf = bp->av_forw;
+	rftab.d_qlen--;
+	rftab.d_nxfer++;
+	bp->b_resid = RFADDR->rfwc;
 	iodone(bp);
 	rfstart();
 }
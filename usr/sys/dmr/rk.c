@@ -24,6 +24,7 @@
 #define	ARDY	0100
 #define	WLO	020000
 #define	CTLRDY	0200
+#define	PS	0177776
 
 struct {
 	int rkds;
@@ -33,6 +34,7 @@ struct {
 	int rkba;
 	int rkda;
 };
+struct { int integ; };
 
 struct	devtab	rktab;
 struct	buf	rrkbuf;
@@ -42,7 +44,7 @@ struct buf *abp;
 {
 	register struct buf *bp;
 	register *qc, *ql;
-	int d;
+	int d, s;
 
 	bp = abp;
 	d = bp->b_dev.d_minor-7;
@@ -53,16 +55,15 @@ struct buf *abp;
 		iodone(bp);
 		return;
 	}
-	bp->av_forw = 0;
+	bp->cylin = rkaddr(bp)>>5;
+	s = PS->integ;
 	spl5();
-	if (rktab.d_actf==0)
-		rktab.d_actf = bp;
-	else
-		rktab.d_actl->av_forw = bp;
-	rktab.d_actl = bp;
+	if (++rktab.d_qlen > rktab.d_qmax)
+		rktab.d_qmax = rktab.d_qlen;
+	disksort(&rktab, bp);
 	if (rktab.d_active==0)
 		rkstart();
-	spl0();
+	PS->integ = s;
 }
 
 rkaddr(bp)
@@ -91,7 +92,8 @@ rkstart()
 	if ((bp = rktab.d_actf) == 0)
 		return;
 	rktab.d_active++;
-	devstart(bp, &RKADDR->rkda, rkaddr(bp), 0);
+	devstart(bp->b_dev.d_minor<8? dmerge(&rktab, bp): bp,
+	    &RKADDR->rkda, rkaddr(bp), 0);
 }
 
 rkintr()
@@ -114,7 +116,10 @@ rkintr()
 	}
 	rktab.d_errcnt = 0;
 	rktab.d_actf = bp->av_forw;
-	iodone(bp);
+	rktab.d_qlen--;
+	rktab.d_nxfer++;
+	bp->b_resid = RKADDR->rkwc;
+	devdone(bp);
 	rkstart();
 }
 
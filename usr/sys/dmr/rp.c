@@ -22,8 +22,10 @@ struct {
 	int	rpda;
 };
 struct { char lbyte, hbyte; };
+struct { int integ; };
 
 #define	RPADDR	0176710
+#define	PS	0177776
 #define	NRP	8
 
 struct {
@@ -59,17 +61,17 @@ struct	buf	rrpbuf;
 
 /*
  * Use av_back to save track+sector,
- * b_resid for cylinder.
+ * b_resid (cylin) for cylinder.
  */
 
 #define	trksec	av_back
-#define	cylin	b_resid
 
 rpstrategy(abp)
 struct buf *abp;
 {
 	register struct buf *bp;
 	register char *p1, *p2;
+	int s;
 
 	bp = abp;
 	p1 = &rp_sizes[bp->b_dev.d_minor&07];
@@ -79,30 +81,20 @@ struct buf *abp;
 		iodone(bp);
 		return;
 	}
-	bp->av_forw = 0;
 	bp->cylin = p1->cyloff;
 	p1 = bp->b_blkno;
 	p2 = lrem(p1, 10);
 	p1 = ldiv(p1, 10);
 	bp->trksec = (p1%20)<<8 | p2;
 	bp->cylin =+ p1/20;
+	s = PS->integ;
 	spl5();
-	if ((p1 = rptab.d_actf)==0)
-		rptab.d_actf = bp;
-	else {
-		for (; p2 = p1->av_forw; p1 = p2) {
-			if (p1->cylin <= bp->cylin
-			 && bp->cylin <  p2->cylin
-			 || p1->cylin >= bp->cylin
-			 && bp->cylin >  p2->cylin) 
-				break;
-		}
-		bp->av_forw = p2;
-		p1->av_forw = bp;
-	}
+	if (++rptab.d_qlen > rptab.d_qmax)
+		rptab.d_qmax = rptab.d_qlen;
+	disksort(&rptab, bp);
 	if (rptab.d_active==0)
 		rpstart();
-	spl0();
+	PS->integ = s;
 }
 
 rpstart()
@@ -113,7 +105,7 @@ rpstart()
 		return;
 	rptab.d_active++;
 	RPADDR->rpda = bp->trksec;
-	devstart(bp, &RPADDR->rpca, bp->cylin, bp->b_dev.d_minor>>3);
+	devstart(dmerge(&rptab, bp), &RPADDR->rpca, bp->cylin, bp->b_dev.d_minor>>3);
 }
 
 rpintr()
@@ -143,8 +135,10 @@ rpintr()
 	}
 	rptab.d_errcnt = 0;
 	rptab.d_actf = bp->av_forw;
+	rptab.d_qlen--;
+	rptab.d_nxfer++;
 	bp->b_resid = RPADDR->rpwc;
-	iodone(bp);
+	devdone(bp);
 	rpstart();
 }
 
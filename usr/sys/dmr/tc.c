@@ -19,11 +19,13 @@ struct {
 	int	tcba;
 	int	tcdt;
 };
+struct { int integ; };
 
 struct	devtab	tctab;
 
 #define	TCADDR	0177340
 #define	NTCBLK	578
+#define	PS	0177776
 
 #define	TAPERR	0100000
 #define	TREV	04000
@@ -55,6 +57,7 @@ tcstrategy(abp)
 struct buf *abp;
 {
 	register struct buf *bp;
+	int s;
 
 	bp = abp;
 	if(bp->b_blkno >= NTCBLK) {
@@ -62,16 +65,15 @@ struct buf *abp;
 		iodone(bp);
 		return;
 	}
-	bp->av_forw = 0;
+	bp->cylin = bp->b_blkno;
+	s = PS->integ;
 	spl6();
-	if (tctab.d_actf==0)
-		tctab.d_actf = bp;
-	else
-		tctab.d_actl->av_forw = bp;
-	tctab.d_actl = bp;
+	if (++tctab.d_qlen > tctab.d_qmax)
+		tctab.d_qmax = tctab.d_qlen;
+	disksort(&tctab, bp);
 	if (tctab.d_active==0)
 		tcstart();
-	spl0();
+	PS->integ = s;
 }
 
 tcstart()
@@ -131,6 +133,9 @@ tcintr()
 	case SIO:
 	done:
 		tctab.d_active = 0;
+		tctab.d_qlen--;
+		tctab.d_nxfer++;
+		bp->b_resid = TCADDR->tcwc;
 		if (tctab.d_actf = bp->av_forw)
 			tcstart();
 		else
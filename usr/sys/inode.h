@@ -24,8 +24,42 @@ struct inode {
 	char	*i_size1;	/**< Low-order word (16 bits) of the file size. This is a char* likely for byte addressing or specific PDP-11 type punning. Effectively part of a 24-bit or 32-bit size. */
 	int	i_addr[8];	/**< Array of block numbers. Addr[0]-addr[6] are direct blocks for small files. Addr[7] can be a double indirect block. For large files (ILARG flag), these can be indirect block pointers. */
 	int	i_lastr;	/**< Last logical block number read (for read-ahead heuristic). */
+	char	i_rawin;	/**< Read-ahead window in blocks. @see NRAHEAD in param.h */
+	int	i_ranext;	/**< Next logical block not yet read ahead. */
+	struct	inode *i_hlink;	/**< Next inode on its hash chain, or on ifreel when i_count is 0. */
+	int	i_xlbn;		/**< First logical block of the cached extent (ILARG files). */
+	int	i_xpbn;		/**< Physical block holding logical block i_xlbn. */
+	int	i_xcnt;		/**< Blocks in the cached extent; 0 if none. */
 } inode[NINODE];		/**< The in-core inode table. @see NINODE in param.h */
 
+struct	inode *ihash[NIHASH];	/**< In-core inode hash chains keyed on (dev, ino). @see NIHASH in param.h */
+struct	inode *ifreel;		/**< Inodes released with i_count 0, ready for reuse. */
+
+/** @brief Hash chain head for inode `ino` of device `dev`. */
+#define	INOHASH(dev, ino)	(&ihash[((dev)+(ino)) & (NIHASH-1)])
+
+/**
+ * @struct ncstat
+ * @brief Directory name cache statistics, counted by nami.c.
+ */
+struct ncstat {
+	int	ns_hit;		/**< Lookups answered with an inode number. */
+	int	ns_neghit;	/**< Lookups answered "no such name". */
+	int	ns_miss;	/**< Lookups that had to search the directory. */
+	int	ns_enter;	/**< Names entered, positive or negative. */
+	int	ns_purge;	/**< Entries discarded when a directory or device went away. */
+} ncstat;
+
+/**
+ * @struct iustat
+ * @brief Inode writeback statistics, counted by iupdat().
+ */
+struct iustat {
+	int	iu_sync;	/**< Inode blocks written at once, because blocks had been freed. */
+	int	iu_delay;	/**< Inode blocks left as delayed writes. */
+	int	iu_coal;	/**< Delayed inode writes to a block already awaiting one. */
+} iustat;
+
 /** @name Inode flags (i_flag) */
 ///@{
 #define	ILOCK	01		/**< Inode is locked (e.g., during manipulation). */
@@ -34,6 +68,8 @@ struct inode {
 #define	IMOUNT	010		/**< Inode is a mount point. */
 #define	IWANT	020		/**< Another process wants to lock this inode. */
 #define	ITEXT	040		/**< Inode is for a pure text segment (sharable). */
+#define	IHASH	0100	/**< Directory's hashed index has been checked and is kept up to date. */
+#define	ISYNC	0200	/**< itrunc is about to free blocks; the inode write must not be delayed. */
 ///@}
 
 /** @name Inode modes (i_mode) - type and permissions */
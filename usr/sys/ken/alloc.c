@@ -101,6 +101,9 @@ struct filsys *getfs(kernel_dev_t dev)
 				fs_ptr->s_ninode = 0;
 				fs_ptr->s_inode[0] = 0;
                 fs_ptr->s_fmod = 1;
+				for(nfree_val = 0; nfree_val < NIMAP; nfree_val++) {
+					mp_iter->m_imap[nfree_val] = 0;
+				}
 			}
 			return(fs_ptr);
 		}
@@ -126,12 +129,54 @@ int badblock(struct filsys *afp, int abn, kernel_dev_t dev)
 	return(0);
 }
 
+/**
+ * @brief Choose which cached free block alloc() hands out next.
+ *
+ * Of the blocks in s_free[1..s_nfree-1], the first one found going
+ * forward from @p goal (wrapping past the end of the device) is
+ * swapped to the top of the cache so that alloc() pops it.  s_free[0]
+ * is never moved: when it is popped it is also the block holding the
+ * next part of the on-disk free list.  With no goal the cache is left
+ * in stack order.
+ * @param fp Superblock of the file system.
+ * @param goal Block the caller would like, 0 for none.
+ */
+static void bgoal(struct filsys *fp, int goal)
+{
+	unsigned int d, best;
+	int i, n, t;
+
+	n = fp->s_nfree - 1;
+	if (goal == 0 || n <= 0) {
+		return;
+	}
+	best = (unsigned int)fp->s_free[n] - (unsigned int)goal;
+	t = n;
+	for (i = 1; i < n && best != 0; i++) {
+		d = (unsigned int)fp->s_free[i] - (unsigned int)goal;
+		if (d < best) {
+			best = d;
+			t = i;
+		}
+	}
+	if (t != n) {
+		i = fp->s_free[t];
+		fp->s_free[t] = fp->s_free[n];
+		fp->s_free[n] = i;
+	}
+}
+
 /**
  * @brief Allocate a free disk block from the specified device.
+ *
+ * The block is taken near @p goal when the superblock's free cache
+ * holds one at or after it, so that consecutive logical blocks of a
+ * file land in consecutive physical blocks.
  * @param dev The device (kernel_dev_t) from which to allocate.
+ * @param goal Preferred block number, or 0 for no preference.
  * @return Pointer to a buffer containing the allocated block (cleared), or NULL on error (u.u_error set).
  */
-struct buf *alloc(kernel_dev_t dev)
+struct buf *alloc(kernel_dev_t dev, int goal)
 {
 	int bno;
 	struct buf *bp;
@@ -148,6 +193,7 @@ struct buf *alloc(kernel_dev_t dev)
     }
 
 	do {
+		bgoal(fp, goal);
 		if (fp->s_nfree <= 0) {
 			prdev("alloc: s_nfree <= 0", dev);
             fp->s_nfree = 0;
@@ -197,72 +243,149 @@ struct buf *alloc(kernel_dev_t dev)
 }
 
 /**
- * @brief Free a disk block on the specified device. (Renamed from original 'free')
+ * @brief Free a batch of disk blocks on the specified device.
+ *
+ * The list is sorted in place, largest block first and zeros last, so
+ * that the blocks come back off the s_free[] stack in ascending order.
+ * The free lock is taken once for the whole batch, and each full
+ * s_free[] spills into the next freed block, so a batch costs at most
+ * one chain block write per 100 blocks.  That write is synchronous
+ * and made under the lock: the disk queue is sorted, so a started
+ * write is not known to finish ahead of a later superblock write, and
+ * the superblock must never point at a chain block that is not yet on
+ * the disk.
  * @param dev Device number (kernel_dev_t).
- * @param bno Block number to free.
+ * @param list Block numbers to free; zero entries are ignored.
+ * @param n Number of entries in @p list.
  */
-void bfree_alloc_c(kernel_dev_t dev, int bno)
+void bfreen(kernel_dev_t dev, int *list, int n)
 {
 	struct filsys *fp;
 	struct buf *bp;
     int *free_list_block_data;
+	int i, j, g, t;
 
 	fp = getfs(dev);
     if (fp == NULL) return;
 
-	fp->s_fmod = 1;
+	for(g = n/2; g > 0; g /= 2) {
+		for(i = g; i < n; i++) {
+			t = list[i];
+			for(j = i; j >= g && (unsigned int)list[j-g] < (unsigned int)t; j -= g) {
+				list[j] = list[j-g];
+			}
+			list[j] = t;
+		}
+	}
 
 	while(fp->s_flock) {
 		sleep((void*)&fp->s_flock, PINOD);
     }
+	fp->s_flock++;
 
-	if (badblock(fp, bno, dev)) {
-		return;
-    }
-
-	if(fp->s_nfree >= 100) {
-		fp->s_flock++;
-		bp = getblk(dev, bno);
-		if (u.u_error) {
-             fp->s_flock = 0;
-             wakeup((void*)&fp->s_flock);
-             prdev("bfree_alloc_c: getblk failed for block to be freed", dev);
-             return;
-        }
-		free_list_block_data = (int *)bp->b_addr;
-		*free_list_block_data++ = fp->s_nfree;
-		bcopy((void*)fp->s_free, (void*)free_list_block_data, 100 * sizeof(int));
-		fp->s_nfree = 0;
-		bwrite(bp);
-		fp->s_flock = 0;
-		wakeup((void*)&fp->s_flock);
+	for(i = 0; i < n && list[i] != 0; i++) {
+		if (badblock(fp, list[i], dev)) {
+			continue;
+		}
+		if(fp->s_nfree >= 100) {
+			bp = getblk(dev, list[i]);
+			if (u.u_error) {
+				prdev("bfreen: getblk failed for block to be freed", dev);
+				break;
+			}
+			free_list_block_data = (int *)bp->b_addr;
+			*free_list_block_data++ = fp->s_nfree;
+			bcopy((void*)fp->s_free, (void*)free_list_block_data, 100 * sizeof(int));
+			fp->s_nfree = 0;
+			bwrite(bp);
+		}
+		fp->s_free[fp->s_nfree++] = list[i];
 	}
-	fp->s_free[fp->s_nfree++] = bno;
+
+	fp->s_flock = 0;
+	wakeup((void*)&fp->s_flock);
 	fp->s_fmod = 1;
 }
 
+/**
+ * @brief Free a disk block on the specified device. (Renamed from original 'free')
+ * @param dev Device number (kernel_dev_t).
+ * @param bno Block number to free.
+ */
+void bfree_alloc_c(kernel_dev_t dev, int bno)
+{
+
+	bfreen(dev, &bno, 1);
+}
+
+
+/**
+ * @brief Find the mount table entry of a mounted device.
+ * @param dev Device number (kernel_dev_t).
+ * @return Pointer to the mount entry, or NULL if @p dev is not mounted.
+ */
+static struct mount *getmp(kernel_dev_t dev)
+{
+	struct mount *mp;
+
+	for(mp = &mount[0]; mp < &mount[NMOUNT]; mp++) {
+		if(mp->m_bufp != NULL && mp->m_dev == dev) {
+			return(mp);
+		}
+	}
+	return(NULL);
+}
 
 /**
  * @brief Allocate a free inode on the specified device.
+ *
+ * Of the inode numbers cached in the superblock, the one nearest
+ * @p goal is handed out.  When the cache is empty it is refilled by
+ * scanning the inode blocks from the mount's rotor, where the last
+ * refill stopped, skipping blocks that m_imap records as holding no
+ * free inode.  A block found to be full is marked there (a free inode
+ * that is still in core keeps its block unmarked); ifree() clears the
+ * mark again, so each block is read about once between
+ * frees and a refill no longer rereads the whole inode list.
  * @param dev Device number (kernel_dev_t).
+ * @param goal Inode number to allocate near, usually the parent directory's; 0 for none.
  * @return Pointer to the locked in-core inode, or NULL on error (u.u_error set).
  */
-struct inode *ialloc(kernel_dev_t dev)
+struct inode *ialloc(kernel_dev_t dev, int goal)
 {
 	struct filsys *fp;
+	struct mount *mp;
 	struct buf *bp;
 	struct dinode *dp_disk_array;
     struct inode *ip_incore_allocated;
-	int i, j, k, current_ino_num;
+	int i, j, k, n, full, current_ino_num;
+	unsigned int d, best;
 
 	fp = getfs(dev);
     if (fp == NULL) return NULL;
+	mp = getmp(dev);
 
 	while(fp->s_ilock) {
 		sleep((void*)&fp->s_ilock, PINOD);
     }
 loop:
 	if(fp->s_ninode > 0) {
+		n = fp->s_ninode - 1;
+		if(goal != 0) {
+			best = (unsigned int)-1;
+			k = n;
+			for(i = 0; i <= n; i++) {
+				j = fp->s_inode[i] - goal;
+				d = j < 0 ? -j : j;
+				if(d < best) {
+					best = d;
+					k = i;
+				}
+			}
+			j = fp->s_inode[k];
+			fp->s_inode[k] = fp->s_inode[n];
+			fp->s_inode[n] = j;
+		}
 		current_ino_num = fp->s_inode[--fp->s_ninode];
 		ip_incore_allocated = iget(dev, current_ino_num);
 
@@ -282,8 +405,14 @@ loop:
 	}
 
 	fp->s_ilock++;
-	current_ino_num = 0;
-	for(i=0; i < fp->s_isize; i++) {
+	i = mp->m_irotor;
+	if(i >= fp->s_isize) {
+		i = 0;
+	}
+	for(n = 0; n < fp->s_isize; n++) {
+		if(i < NIMAP*8 && (mp->m_imap[i>>3] & (1<<(i&7))) != 0) {
+			goto next;
+		}
 		bp = bread(dev, i+2);
 		if (u.u_error) {
             if(bp) brelse(bp);
@@ -293,28 +422,41 @@ loop:
             return NULL;
         }
 		dp_disk_array = (struct dinode *)bp->b_addr;
+		current_ino_num = i*(BSIZE/sizeof(struct dinode));
+		full = 1;
 		for(j=0; j < (BSIZE/sizeof(struct dinode)); j++) {
 			current_ino_num++;
 			if(dp_disk_array[j].di_mode != 0) {
 				continue;
             }
-			for(k=0; k<NINODE; k++) {
-				if(inode[k].i_count > 0 && inode[k].i_dev==dev && inode[k].i_number==current_ino_num) {
+			for(ip_incore_allocated = *INOHASH(dev, current_ino_num); ip_incore_allocated != NULL;
+			    ip_incore_allocated = ip_incore_allocated->i_hlink) {
+				if(ip_incore_allocated->i_dev==dev && ip_incore_allocated->i_number==current_ino_num) {
+					full = 0;
 					goto cont;
                 }
             }
 			if (fp->s_ninode < 100) {
                 fp->s_inode[fp->s_ninode++] = current_ino_num;
             } else {
+                full = 0;
                 break;
             }
 		cont:;
 		}
 		brelse(bp);
+		if(full && i < NIMAP*8) {
+			mp->m_imap[i>>3] |= 1<<(i&7);
+		}
 		if(fp->s_ninode >= 100) {
 			break;
         }
+	next:
+		if(++i >= fp->s_isize) {
+			i = 0;
+		}
 	}
+	mp->m_irotor = i;
 
 	fp->s_ilock = 0;
 	wakeup((void*)&fp->s_ilock);
@@ -330,17 +472,25 @@ loop:
 
 /**
  * @brief Free an in-core inode. (Called by iput when link count is zero)
- * Adds the inode number to the free inode cache in the superblock.
+ * Adds the inode number to the free inode cache in the superblock and
+ * clears the full mark on its inode block so the next refill looks there.
  * @param dev Device (kernel_dev_t) of the inode.
  * @param ino Inode number to free.
  */
 void ifree(kernel_dev_t dev, int ino)
 {
 	struct filsys *fp;
+	struct mount *mp;
+	int i;
 
 	fp = getfs(dev);
     if (fp == NULL) return;
 
+	mp = getmp(dev);
+	i = (ino-1) / (BSIZE/sizeof(struct dinode));
+	if(i < NIMAP*8) {
+		mp->m_imap[i>>3] &= ~(1<<(i&7));
+	}
 	if(fp->s_ilock) {
 		return;
     }
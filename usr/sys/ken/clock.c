@@ -17,7 +17,6 @@ struct	{
 
 clock(dev, sp, r1, nps, r0, pc, ps)
 {
-	register struct callo *p1, *p2;
 	register struct proc *pp;
 
 	/*
@@ -34,21 +33,11 @@ clock(dev, sp, r1, nps, r0, pc, ps)
 
 	/*
 	 * callouts
-	 * if none, just return
-	 * else update first non-zero time
-	 */
-
-	if(callout[0].c_func == 0)
-		goto out;
-	p2 = &callout[0];
-	while(p2->c_time<=0 && p2->c_func!=0)
-		p2++;
-	p2->c_time--;
-
-	/*
-	 * if ps is high, just return
+	 * count the tick; if ps is high,
+	 * the wheel catches up later
 	 */
 
+	cpend++;
 	if((ps&0340) != 0)
 		goto out;
 
@@ -57,19 +46,9 @@ clock(dev, sp, r1, nps, r0, pc, ps)
 	 */
 
 	spl5();
-	if(callout[0].c_time <= 0) {
-		p1 = &callout[0];
-		while(p1->c_func != 0 && p1->c_time <= 0) {
-			(*p1->c_func)(p1->c_arg);
-			p1++;
-		}
-		p2 = &callout[0];
-		while(p2->c_func = p1->c_func) {
-			p2->c_time = p1->c_time;
-			p2->c_arg = p1->c_arg;
-			p1++;
-			p2++;
-		}
+	while(cpend > 0) {
+		cpend--;
+		ctick();
 	}
 
 	/*
@@ -95,9 +74,6 @@ out:
 			wakeup(tout);
 		if((time[1]&03) == 0)
 			wakeup(&lbolt);
-		for(pp = &proc[0]; pp < &proc[NPROC]; pp++)
-		if(pp->p_time != 127)
-			pp->p_time++;
 		if(runin!=0) {
 			runin = 0;
 			wakeup(&runin);
@@ -115,32 +91,130 @@ out:
 	}
 }
 
+/*
+ * The callout wheel.
+ * An entry due in t ticks hangs on
+ * slot (cwhere+t)%NCWHEEL with c_time
+ * the number of whole turns it must
+ * wait.  Each tick clock moves cwhere
+ * on one slot and looks only at the
+ * entries there, so neither timeout
+ * nor untimeout depends on how many
+ * callouts are pending.
+ */
+struct	callo *calwheel[NCWHEEL];
+struct	callo *calfree;
+int	cwhere;
+int	cpend;
+int	callinit;
+
+/*
+ * Turn the wheel one tick and
+ * call what has come due.  The due
+ * entries are unhooked at spl7 and
+ * then called at spl5, so they may
+ * set or cancel callouts themselves.
+ */
+ctick()
+{
+	register struct callo *p1, *p2, *due;
+	int (*fun)(), arg;
+
+	spl7();
+	cwhere = (cwhere+1) & (NCWHEEL-1);
+	due = 0;
+	for(p1 = calwheel[cwhere]; p1; p1 = p2) {
+		p2 = p1->c_next;
+		if(p1->c_time > 0) {
+			p1->c_time--;
+			continue;
+		}
+		if(*p1->c_back = p2)
+			p2->c_back = p1->c_back;
+		p1->c_back = 0;
+		p1->c_next = due;
+		due = p1;
+	}
+	spl5();
+	while(p1 = due) {
+		due = p1->c_next;
+		fun = p1->c_func;
+		arg = p1->c_arg;
+		spl7();
+		p1->c_func = 0;
+		p1->c_next = calfree;
+		calfree = p1;
+		spl5();
+		(*fun)(arg);
+	}
+}
+
+/*
+ * Call fun(arg) in tim ticks.
+ * The entry is returned so the
+ * caller can cancel it by untimeout.
+ */
 timeout(fun, arg, tim)
 {
-	register struct callo *p1, *p2;
+	register struct callo *p1, **p2;
 	register t;
 	int s;
 
 	t = tim;
+	if(t <= 0)
+		t = 1;
 	s = PS->integ;
-	p1 = &callout[0];
 	spl7();
-	while(p1->c_func != 0 && p1->c_time <= t) {
-		t =- p1->c_time;
-		p1++;
-	}
-	p1->c_time =- t;
-	p2 = p1;
-	while(p2->c_func != 0)
-		p2++;
-	while(p2 >= p1) {
-		(p2+1)->c_time = p2->c_time;
-		(p2+1)->c_func = p2->c_func;
-		(p2+1)->c_arg = p2->c_arg;
-		p2--;
+	if(callinit == 0) {
+		callinit++;
+		for(p1 = &callout[0]; p1 < &callout[NCALL]; p1++) {
+			p1->c_next = calfree;
+			calfree = p1;
+		}
 	}
-	p1->c_time = t;
+	if((p1 = calfree) == 0)
+		panic("callout table overflow");
+	calfree = p1->c_next;
+	p1->c_time = (t-1) >> 6;
 	p1->c_func = fun;
 	p1->c_arg = arg;
+	p2 = &calwheel[(cwhere+t) & (NCWHEEL-1)];
+	if(p1->c_next = *p2)
+		(*p2)->c_back = &p1->c_next;
+	p1->c_back = p2;
+	*p2 = p1;
+	PS->integ = s;
+	return(p1);
+}
+
+/*
+ * Cancel a callout set by timeout,
+ * given what timeout returned and
+ * the same fun and arg; the check
+ * makes it harmless to cancel one
+ * that has already been called.
+ * Returns 1 if it was still pending.
+ */
+untimeout(p, fun, arg)
+struct callo *p;
+{
+	register struct callo *p1;
+	int s;
+
+	p1 = p;
+	s = PS->integ;
+	spl7();
+	if(p1 == 0 || p1->c_func != fun || p1->c_arg != arg ||
+	   p1->c_back == 0) {
+		PS->integ = s;
+		return(0);
+	}
+	if(*p1->c_back = p1->c_next)
+		p1->c_next->c_back = p1->c_back;
+	p1->c_back = 0;
+	p1->c_func = 0;
+	p1->c_next = calfree;
+	calfree = p1;
 	PS->integ = s;
+	return(1);
 }
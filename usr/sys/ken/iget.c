@@ -21,10 +21,10 @@ int ino;
 	register *ip2;
 	int *ip1;
 	register struct mount *ip;
+	struct inode **hp;
 
 loop:
-	ip = NULL;
-	for(p = &inode[0]; p < &inode[NINODE]; p++) {
+	for(p = *INOHASH(dev, ino); p != NULL; p = p->i_hlink) {
 		if(dev==p->i_dev && ino==p->i_number) {
 			if((p->i_flag&ILOCK) != 0) {
 				p->i_flag =| IWANT;
@@ -44,18 +44,30 @@ loop:
 			p->i_flag =| ILOCK;
 			return(p);
 		}
-		if(ip==NULL && p->i_count==0)
-			ip = p;
 	}
-	if((p=ip) == NULL)
-		panic("no inodes");
-	if (p>maxip)
+	if((p = ifreel) != NULL)
+		ifreel = p->i_hlink;
+	else {
+		/*
+		 * Nothing released yet: take the
+		 * next slot never used.
+		 */
+		p = maxip==NULL? &inode[0]: maxip+1;
+		if(p >= &inode[NINODE])
+			panic("no inodes");
 		maxip = p;
+	}
 	p->i_dev = dev;
 	p->i_number = ino;
+	hp = INOHASH(dev, ino);
+	p->i_hlink = *hp;
+	*hp = p;
 	p->i_flag = ILOCK;
 	p->i_count++;
 	p->i_lastr = -1;
+	p->i_rawin = 0;
+	p->i_ranext = 0;
+	p->i_xcnt = 0;
 	ip = bread(dev, ldiv(ino+31,16));
 	ip1 = ip->b_addr + 32*lrem(ino+31, 16);
 	ip2 = &p->i_mode;
@@ -74,19 +86,42 @@ struct inode *p;
 	if(rp->i_count == 1) {
 		rp->i_flag =| ILOCK;
 		if(rp->i_nlink <= 0) {
+			if((rp->i_mode&IFMT) == IFDIR)
+				ncinval(rp->i_dev, rp->i_number);
 			itrunc(rp);
 			rp->i_mode = 0;
+			rp->i_flag =| IUPD;
 			ifree(rp->i_dev, rp->i_number);
 		}
 		iupdat(rp, time);
 		prele(rp);
 		rp->i_flag = 0;
+		iunhash(rp);
 		rp->i_number = 0;
 	}
-	rp->i_count--;
+	if(--rp->i_count == 0) {
+		rp->i_hlink = ifreel;
+		ifreel = rp;
+	}
 	prele(rp);
 }
 
+/*
+ * Take an inode off its hash chain
+ * when it gives up its identity.
+ */
+iunhash(p)
+struct inode *p;
+{
+	register struct inode **hp;
+
+	for(hp = INOHASH(p->i_dev, p->i_number); *hp != NULL; hp = &(*hp)->i_hlink)
+		if(*hp == p) {
+			*hp = p->i_hlink;
+			return;
+		}
+}
+
 iupdat(p, tm)
 int *p;
 int *tm;
@@ -110,44 +145,80 @@ int *tm;
 		} else
 			ip1 =+ 2;
 		if(rp->i_flag&IUPD) {
-			*ip1++ = *tm++;
-			*ip1++ = *tm;
+			*ip1++ = tm[0];
+			*ip1++ = tm[1];
+		}
+		/*
+		 * an inode about to give up blocks
+		 * (itrunc) goes out now, before they
+		 * reach the free list; the rest wait
+		 * in the cache and share one write
+		 * per block
+		 */
+		if(rp->i_flag&ISYNC) {
+			iustat.iu_sync++;
+			bwrite(bp);
+		} else {
+			iustat.iu_delay++;
+			if(bp->b_flags&B_DELWRI)
+				iustat.iu_coal++;
+			bdwrite(bp);
 		}
-		bwrite(bp);
+		if(rp->i_flag&IUPD)
+			dhstamp(rp, tm);
+		rp->i_flag =& ~(IUPD|IACC|ISYNC);
 	}
 }
 
+/*
+ * Free all the blocks of a file.
+ * The inode is cleared and written
+ * out first, so the disk never shows
+ * it holding blocks that are already
+ * on the free list.  Each indirect
+ * block is then handed to bfreen as
+ * one batch, in place, and then the
+ * eight saved addresses.
+ */
 itrunc(ip)
 int *ip;
 {
-	register *rp, *bp, *cp;
+	register *rp, *bp, i;
+	int addr[8], large;
 
 	rp = ip;
 	if((rp->i_mode&(IFCHR&IFBLK)) != 0)
 		return;
-	for(ip = &rp->i_addr[0]; ip < &rp->i_addr[8]; ip++)
-	if(*ip) {
-		if((rp->i_mode&ILARG) != 0) {
-			bp = bread(rp->i_dev, *ip);
-			for(cp = bp->b_addr; cp < bp->b_addr+512; cp++)
-				if(*cp)
-					free(rp->i_dev, *cp);
-			brelse(bp);
-		}
-		free(rp->i_dev, *ip);
-		*ip = 0;
+	large = rp->i_mode&ILARG;
+	for(i=0; i<8; i++) {
+		addr[i] = rp->i_addr[i];
+		if(addr[i])
+			rp->i_flag =| ISYNC;
+		rp->i_addr[i] = 0;
 	}
 	rp->i_mode =& ~ILARG;
+	rp->i_xcnt = 0;
 	rp->i_size0 = 0;
 	rp->i_size1 = 0;
 	rp->i_flag =| IUPD;
+	if((rp->i_flag&ISYNC) == 0)
+		return;
+	iupdat(rp, time);
+	if(large)
+		for(i=0; i<8; i++)
+		if(addr[i]) {
+			bp = bread(rp->i_dev, addr[i]);
+			bfreen(rp->i_dev, bp->b_addr, 256);
+			brelse(bp);
+		}
+	bfreen(rp->i_dev, addr, 8);
 }
 
 maknode(mode)
 {
 	register *ip;
 
-	ip = ialloc(u.u_pdir->i_dev);
+	ip = ialloc(u.u_pdir->i_dev, u.u_pdir->i_number);
 	ip->i_flag =| IACC|IUPD;
 	ip->i_mode = mode|IALLOC;
 	ip->i_nlink = 1;
@@ -170,5 +241,7 @@ int *ip;
 	u.u_segflg = 1;
 	u.u_base = &u.u_dent;
 	writei(u.u_pdir);
+	dhadd(u.u_pdir);
+	ncenter(u.u_pdir, ip->i_number);
 	iput(u.u_pdir);
 }
@@ -8,6 +8,30 @@
 #include "../user.h"
 #include "../systm.h"
 #include "../buf.h"
+#include "../filsys.h"
+
+/*
+ * Directory name cache.
+ * Maps (device, directory inode, name in
+ * u.u_dbuf) to the inode number found there,
+ * or to 0 if the name is known not to be there.
+ * Entries are replaced in turn; wdir and unlink
+ * keep them current, and they are discarded
+ * when a directory is freed or its device
+ * unmounted.
+ */
+
+#define	NNCHASH	16
+
+struct	ncache {
+	struct	ncache *nc_hlink;
+	int	nc_dev;
+	int	nc_dino;
+	int	nc_ino;
+	char	nc_name[DIRSIZ];
+} ncache[NNCACHE];
+struct	ncache *nchash[NNCHASH];
+int	nchand;
 
 namei(func, flag)
 int (*func)();
@@ -28,7 +52,8 @@ int flag;
 	register struct inode *dp;
 	register c;
 	register char *cp;
-	int eo, *bp;
+	int eo, *bp, *wp, *np, *xp, n;
+	struct ncache *ncp;
 
 	/*
 	 * start from indicated
@@ -90,7 +115,60 @@ cloop:
 		goto out;
 
 	/*
-	 * search the directory
+	 * try the name cache, except for the
+	 * last component of a create or delete,
+	 * which needs the place in the directory
+	 */
+
+	if(flag==0 || c!='\0') {
+		if((ncp = nclook(dp)) != NULL) {
+			if(ncp->nc_ino == 0) {
+				u.u_error = ENOENT;
+				goto out;
+			}
+			u.u_dent.u_ino = ncp->nc_ino;
+			goto found;
+		}
+	}
+
+	/*
+	 * a large directory with a good
+	 * hashed index is searched through
+	 * it; the index is built only for a
+	 * create or delete.
+	 */
+
+	if(dhok(dp, flag!=0 && c=='\0')) {
+		u.u_segflg = 1;
+		u.u_offset[0] = 0;
+		u.u_count = 0;
+		if((n = dhfind(dp)) >= 0) {
+			u.u_offset[1] = (n+1)<<4;
+			ncenter(dp, u.u_dent.u_ino);
+			goto found;
+		}
+		if(flag==1 && c=='\0') {
+			if(access(dp, IWRITE))
+				goto out;
+			u.u_pdir = dp;
+			if((n = dhslot(dp)) >= 0)
+				u.u_offset[1] = n<<4; else {
+				u.u_offset[1] = dp->i_size1;
+				dp->i_flag =| IUPD;
+			}
+			return(NULL);
+		}
+		ncenter(dp, 0);
+		u.u_error = ENOENT;
+		goto out;
+	}
+
+	/*
+	 * search the directory a block at a time,
+	 * comparing the names in place a word at
+	 * a time.  On a match u.u_offset is just
+	 * past the entry and u.u_dent holds it;
+	 * eo is just past the first empty slot.
 	 */
 
 	u.u_offset[1] = 0;
@@ -98,12 +176,9 @@ cloop:
 	u.u_segflg = 1;
 	eo = 0;
 	u.u_count = ldiv(dp->i_size1, DIRSIZ+2);
-	bp = NULL;
 
 eloop:
 	if(u.u_count == 0) {
-		if(bp != NULL)
-			brelse(bp);
 		if(flag==1 && c=='\0') {
 			if(access(dp, IWRITE))
 				goto out;
@@ -113,28 +188,37 @@ eloop:
 				dp->i_flag =| IUPD;
 			return(NULL);
 		}
+		ncenter(dp, 0);
 		u.u_error = ENOENT;
 		goto out;
 	}
-	if((u.u_offset[1]&0777) == 0) {
-		if(bp != NULL)
-			brelse(bp);
-		bp = bread(dp->i_dev,
-			bmap(dp, ldiv(u.u_offset[1], 512)));
-	}
-	bcopy(bp->b_addr+(u.u_offset[1]&0777), &u.u_dent, (DIRSIZ+2)/2);
-	u.u_offset[1] =+ DIRSIZ+2;
-	u.u_count--;
-	if(u.u_dent.u_ino == 0) {
-		if(eo == 0)
-			eo = u.u_offset[1];
-		goto eloop;
-	}
-	for(cp = &u.u_dbuf[0]; cp < &u.u_dbuf[DIRSIZ]; cp++)
-		if(*cp != cp[u.u_dent.u_name - u.u_dbuf])
-			goto eloop;
-	if(bp != NULL)
-		brelse(bp);
+	bp = bread(dp->i_dev,
+		bmap(dp, ldiv(u.u_offset[1], 512)));
+	n = min(u.u_count, 512/(DIRSIZ+2));
+	u.u_count =- n;
+	for(wp = bp->b_addr; n > 0; n--, wp =+ (DIRSIZ+2)/2) {
+		u.u_offset[1] =+ DIRSIZ+2;
+		if(wp[0] == 0) {
+			if(eo == 0)
+				eo = u.u_offset[1];
+			continue;
+		}
+		xp = wp;
+		for(np = u.u_dbuf; np < &u.u_dbuf[DIRSIZ]; np++)
+			if(*++xp != *np)
+				goto nomatch;
+		goto match;
+	nomatch:;
+	}
+	brelse(bp);
+	goto eloop;
+
+match:
+	u.u_count =+ n-1;
+	bcopy(wp, &u.u_dent, (DIRSIZ+2)/2);
+	brelse(bp);
+	ncenter(dp, u.u_dent.u_ino);
+found:
 	if(flag==2 && c=='\0') {
 		if(access(dp, IWRITE))
 			goto out;
@@ -152,6 +236,503 @@ out:
 	return(NULL);
 }
 
+nchashp(dev, dino, name)
+char *name;
+{
+	register char *cp;
+	register h;
+
+	h = dev + dino;
+	for(cp = name; cp < name+DIRSIZ; cp++)
+		h =+ *cp;
+	return(&nchash[h & (NNCHASH-1)]);
+}
+
+nclook(dp)
+struct inode *dp;
+{
+	register struct ncache *ncp;
+
+	if((ncp = ncfind(dp)) == NULL)
+		ncstat.ns_miss++;
+	else if(ncp->nc_ino)
+		ncstat.ns_hit++;
+	else
+		ncstat.ns_neghit++;
+	return(ncp);
+}
+
+ncfind(dp)
+struct inode *dp;
+{
+	register struct ncache *ncp;
+	register char *cp1, *cp2;
+
+	for(ncp = *nchashp(dp->i_dev, dp->i_number, u.u_dbuf); ncp != NULL; ncp = ncp->nc_hlink) {
+		if(ncp->nc_dino != dp->i_number || ncp->nc_dev != dp->i_dev)
+			continue;
+		cp1 = ncp->nc_name;
+		for(cp2 = u.u_dbuf; cp2 < &u.u_dbuf[DIRSIZ]; cp2++)
+			if(*cp1++ != *cp2)
+				goto next;
+		return(ncp);
+	next:;
+	}
+	return(NULL);
+}
+
+/*
+ * Record that the name in u.u_dbuf
+ * is ino (0 for absent) in directory dp.
+ */
+ncenter(dp, ino)
+struct inode *dp;
+{
+	register struct ncache *ncp, **hp;
+	register char *cp;
+	char *cp1;
+
+	if((ncp = ncfind(dp)) == NULL) {
+		ncp = &ncache[nchand];
+		if(++nchand >= NNCACHE)
+			nchand = 0;
+		ncunhash(ncp);
+		ncp->nc_dev = dp->i_dev;
+		ncp->nc_dino = dp->i_number;
+		cp1 = ncp->nc_name;
+		for(cp = u.u_dbuf; cp < &u.u_dbuf[DIRSIZ];)
+			*cp1++ = *cp++;
+		hp = nchashp(ncp->nc_dev, ncp->nc_dino, ncp->nc_name);
+		ncp->nc_hlink = *hp;
+		*hp = ncp;
+	}
+	ncp->nc_ino = ino;
+	ncstat.ns_enter++;
+}
+
+ncunhash(ncp)
+struct ncache *ncp;
+{
+	register struct ncache **hp;
+
+	if(ncp->nc_dino == 0)
+		return;
+	for(hp = nchashp(ncp->nc_dev, ncp->nc_dino, ncp->nc_name); *hp != NULL; hp = &(*hp)->nc_hlink)
+		if(*hp == ncp) {
+			*hp = ncp->nc_hlink;
+			break;
+		}
+	ncp->nc_dino = 0;
+}
+
+/*
+ * Discard the entries for directory dino
+ * on dev, or for all of dev if dino is 0.
+ */
+ncinval(dev, dino)
+{
+	register struct ncache *ncp;
+
+	for(ncp = &ncache[0]; ncp < &ncache[NNCACHE]; ncp++)
+		if(ncp->nc_dino != 0 && ncp->nc_dev == dev &&
+		    (dino == 0 || ncp->nc_dino == dino)) {
+			ncunhash(ncp);
+			ncstat.ns_purge++;
+		}
+}
+
+/*
+ * Hashed index for large directories.
+ * A directory that has gone large (ILARG) but
+ * is still under 64K bytes keeps a header block
+ * at logical block DHBASE and NDHB bucket blocks
+ * after it.  i_size does not cover them, so a
+ * kernel that knows nothing of the index never
+ * reads them and sees only the plain entries.
+ *
+ * The header holds DHMAGIC, the directory's
+ * modification time when the index was last
+ * right, and a stack of empty slots.  A bucket
+ * word is three more bits of the name's hash
+ * over the slot number plus one; 0 is unused.
+ * A directory too big for its buckets has
+ * DHFULL and its size in slots in the header
+ * instead, and is not tried again unless it
+ * is smaller.
+ *
+ * The index is believed only while its time
+ * matches the inode's on disk.  Once checked, the
+ * inode is marked IHASH and wdir, unlink and iupdat
+ * keep the index and the time in step.  A directory
+ * changed by any other means is reindexed.
+ *
+ * A name missing from the index is taken to be
+ * missing from the directory, so the buckets on
+ * disk must never lack a name that is there:
+ * a new entry's bucket is written at once, a
+ * removed entry's directory block is written
+ * before its bucket is cleared, and a new index
+ * is written before the header that vouches for
+ * it.  Stale words are harmless, as every hit is
+ * checked against the entry itself; the stack
+ * of empty slots is only a hint.
+ */
+
+#define	DHMAGIC	0143721
+#define	DHFULL	0143722
+#define	NDHP	4		/* bucket blocks filled per pass */
+
+dhok(ip, build)
+struct inode *ip;
+{
+	register struct inode *rp;
+	register *hp, *mp;
+	int *bp, *mbp, i, b, t0, t1;
+
+	rp = ip;
+	if((rp->i_mode&ILARG)==0 || rp->i_size0!=0 ||
+	    getfs(rp->i_dev)->s_ronly) {
+		rp->i_flag =& ~IHASH;
+		return(0);
+	}
+	if(rp->i_flag&IHASH)
+		return(1);
+	if((b = bmapr(rp, DHBASE)) == 0) {
+		if(!build)
+			return(0);
+		if((b = bmap(rp, DHBASE)) == 0) {
+			u.u_error = 0;
+			return(0);
+		}
+	}
+	i = rp->i_number+31;
+	mbp = bread(rp->i_dev, ldiv(i, 16));
+	mp = mbp->b_addr + 32*lrem(i, 16);
+	t0 = mp[14];
+	t1 = mp[15];
+	brelse(mbp);
+	bp = bread(rp->i_dev, b);
+	hp = bp->b_addr;
+	i = hp[0];
+	if(i == DHFULL && ldiv(rp->i_size1, DIRSIZ+2) >= hp[3]) {
+		brelse(bp);
+		return(0);
+	}
+	if(hp[1]!=t0 || hp[2]!=t1)
+		i = 0;
+	brelse(bp);
+	if(i == DHMAGIC) {
+		rp->i_flag =| IHASH;
+		return(1);
+	}
+	if(!build)
+		return(0);
+	return(dhbuild(rp, b, t0, t1));
+}
+
+/*
+ * Index every entry of the directory, whose
+ * header is block hb, NDHP bucket blocks to
+ * a pass, and stack up the empty slots.  The
+ * buckets are all allocated before anything
+ * is written, and the directory's own blocks
+ * go to disk first, so what the index covers
+ * is what the disk holds.
+ */
+dhbuild(ip, hb, t0, t1)
+struct inode *ip;
+{
+	register *wp, s, h;
+	int *hbp, *dbp, *kbp[NDHP], *hp, b, k, n;
+
+	n = ldiv(ip->i_size1, DIRSIZ+2);
+	for(b=0; b<NDHB; b++)
+		if(bmap(ip, DHBASE+1+b) == 0) {
+			u.u_error = 0;
+			return(0);
+		}
+	for(s=0; s<n; s =+ 32) {
+		dbp = bread(ip->i_dev, bmap(ip, s>>5));
+		if(dbp->b_flags&B_DELWRI)
+			bwrite(dbp); else
+			brelse(dbp);
+	}
+	hbp = bread(ip->i_dev, hb);
+	hp = hbp->b_addr;
+	hp[0] = 0;
+	hp[3] = 0;
+	for(b=0; b<NDHB; b =+ NDHP) {
+		for(k=0; k<NDHP; k++) {
+			kbp[k] = bread(ip->i_dev, bmap(ip, DHBASE+1+b+k));
+			clrbuf(kbp[k]);
+		}
+		dbp = NULL;
+		for(s=0; s<n; s++) {
+			if((s&037) == 0) {
+				if(dbp != NULL)
+					brelse(dbp);
+				dbp = bread(ip->i_dev, bmap(ip, s>>5));
+			}
+			wp = dbp->b_addr + ((s&037)<<4);
+			if(*wp == 0) {
+				if(b == 0 && hp[3] < 256-4)
+					hp[4 + hp[3]++] = s;
+				continue;
+			}
+			h = dhash(wp+1);
+			k = (h&(NDHB-1)) - b;
+			if(k >= 0 && k < NDHP && !dhins(kbp[k], (h>>5&07)<<13 | s+1))
+				goto full;
+		}
+		if(dbp != NULL)
+			brelse(dbp);
+		for(k=0; k<NDHP; k++)
+			bwrite(kbp[k]);
+	}
+	hp[0] = DHMAGIC;
+	hp[1] = t0;
+	hp[2] = t1;
+	bdwrite(hbp);
+	ip->i_flag =| IHASH;
+	return(1);
+
+full:
+	brelse(dbp);
+	for(k=0; k<NDHP; k++)
+		brelse(kbp[k]);
+	hp[0] = DHFULL;
+	hp[3] = n;
+	bdwrite(hbp);
+	return(0);
+}
+
+dhash(name)
+char *name;
+{
+	register char *cp;
+	register h;
+
+	h = 0;
+	for(cp = name; cp < name+DIRSIZ; cp++)
+		h = (h<<3) + (h>>13&07) + *cp;
+	return(h);
+}
+
+dhins(bp, w)
+int *bp;
+{
+	register *p;
+
+	for(p = bp->b_addr; p < bp->b_addr+512; p++)
+		if(*p == 0) {
+			*p = w;
+			return(1);
+		}
+	return(0);
+}
+
+/*
+ * Look for the name in u.u_dbuf.
+ * Return its slot with the entry in
+ * u.u_dent, or -1.
+ */
+dhfind(ip)
+struct inode *ip;
+{
+	register *wp, *np, s;
+	int *bp, *dbp, *xp, h, lbn;
+
+	h = dhash(u.u_dbuf);
+	if((s = bmapr(ip, DHBASE+1+(h&(NDHB-1)))) == 0)
+		return(-1);
+	bp = bread(ip->i_dev, s);
+	dbp = NULL;
+	for(xp = bp->b_addr; xp < bp->b_addr+512; xp++) {
+		if(*xp == 0 || (*xp>>13&07) != (h>>5&07))
+			continue;
+		s = (*xp&017777) - 1;
+		if(s >= ldiv(ip->i_size1, DIRSIZ+2))
+			continue;
+		if(dbp == NULL || lbn != s>>5) {
+			if(dbp != NULL)
+				brelse(dbp);
+			lbn = s>>5;
+			dbp = bread(ip->i_dev, bmap(ip, lbn));
+		}
+		wp = dbp->b_addr + ((s&037)<<4);
+		if(*wp == 0)
+			continue;
+		for(np = u.u_dbuf; np < &u.u_dbuf[DIRSIZ]; np++)
+			if(*++wp != *np)
+				goto next;
+		bcopy(dbp->b_addr + ((s&037)<<4), &u.u_dent, (DIRSIZ+2)/2);
+		brelse(dbp);
+		brelse(bp);
+		return(s);
+	next:;
+	}
+	if(dbp != NULL)
+		brelse(dbp);
+	brelse(bp);
+	return(-1);
+}
+
+/*
+ * An empty slot for a new entry, from
+ * the top of the header's stack, or -1
+ * to append.  Slots that have been filled
+ * behind the index's back are dropped.
+ */
+dhslot(ip)
+struct inode *ip;
+{
+	register *hp, s;
+	int *hbp, *dbp, *wp;
+
+	if((s = bmapr(ip, DHBASE)) == 0)
+		return(-1);
+	hbp = bread(ip->i_dev, s);
+	hp = hbp->b_addr;
+	while(hp[3] > 0) {
+		s = hp[3+hp[3]];
+		if(s < ldiv(ip->i_size1, DIRSIZ+2)) {
+			dbp = bread(ip->i_dev, bmap(ip, s>>5));
+			wp = dbp->b_addr + ((s&037)<<4);
+			if(*wp == 0) {
+				brelse(dbp);
+				brelse(hbp);
+				return(s);
+			}
+			brelse(dbp);
+		}
+		hp[3]--;
+	}
+	bdwrite(hbp);
+	return(-1);
+}
+
+/*
+ * wdir has written the name in u.u_dbuf
+ * into the slot before u.u_offset.
+ */
+dhadd(ip)
+struct inode *ip;
+{
+	register *hp, s, h;
+	int *bp, b;
+
+	if((ip->i_flag&IHASH) == 0)
+		return;
+	if(ip->i_size0 != 0) {
+		ip->i_flag =& ~IHASH;
+		return;
+	}
+	s = ldiv(u.u_offset[1], DIRSIZ+2) - 1;
+	h = dhash(u.u_dbuf);
+	if((b = bmapr(ip, DHBASE+1+(h&(NDHB-1)))) == 0) {
+		dhkill(ip, 0);
+		return;
+	}
+	bp = bread(ip->i_dev, bmap(ip, DHBASE));
+	hp = bp->b_addr;
+	if(hp[3] > 0 && hp[3+hp[3]] == s) {
+		hp[3]--;
+		bdwrite(bp);
+	} else
+		brelse(bp);
+	bp = bread(ip->i_dev, b);
+	if(dhins(bp, (h>>5&07)<<13 | s+1))
+		bwrite(bp);
+	else {
+		brelse(bp);
+		dhkill(ip, DHFULL);
+	}
+}
+
+/*
+ * unlink has cleared the entry for the
+ * name in u.u_dbuf before u.u_offset.
+ */
+dhdel(ip)
+struct inode *ip;
+{
+	register *p, s, h;
+	int *bp, w, b;
+
+	if((ip->i_flag&IHASH) == 0)
+		return;
+	s = ldiv(u.u_offset[1], DIRSIZ+2) - 1;
+	h = dhash(u.u_dbuf);
+	w = (h>>5&07)<<13 | s+1;
+	if((b = bmapr(ip, DHBASE+1+(h&(NDHB-1)))) == 0) {
+		dhkill(ip, 0);
+		return;
+	}
+	bwrite(bread(ip->i_dev, bmap(ip, s>>5)));
+	bp = bread(ip->i_dev, b);
+	for(p = bp->b_addr; p < bp->b_addr+512; p++)
+		if(*p == w) {
+			*p = 0;
+			bdwrite(bp);
+			bp = bread(ip->i_dev, bmap(ip, DHBASE));
+			p = bp->b_addr;
+			if(p[3] < 256-4)
+				p[4 + p[3]++] = s;
+			bdwrite(bp);
+			return;
+		}
+	brelse(bp);
+	dhkill(ip, 0);
+}
+
+/*
+ * iupdat has given the directory
+ * modification time tm on disk.
+ */
+dhstamp(ip, tm)
+struct inode *ip;
+int *tm;
+{
+	register *hp, b;
+	int *bp;
+
+	if((ip->i_flag&IHASH) == 0)
+		return;
+	if((b = bmapr(ip, DHBASE)) == 0) {
+		ip->i_flag =& ~IHASH;
+		return;
+	}
+	bp = bread(ip->i_dev, b);
+	hp = bp->b_addr;
+	hp[1] = tm[0];
+	hp[2] = tm[1];
+	bdwrite(bp);
+}
+
+/*
+ * The index is out of step; have it
+ * rebuilt when next used, or if how is
+ * DHFULL, given up until the directory
+ * is smaller.  The header goes out at
+ * once, as it no longer covers entries
+ * that may reach the disk.
+ */
+dhkill(ip, how)
+struct inode *ip;
+{
+	int *bp, *hp, b;
+
+	ip->i_flag =& ~IHASH;
+	if((b = bmapr(ip, DHBASE)) == 0)
+		return;
+	bp = bread(ip->i_dev, b);
+	hp = bp->b_addr;
+	hp[0] = how;
+	if(how == DHFULL)
+		hp[3] = ldiv(ip->i_size1, DIRSIZ+2);
+	bwrite(bp);
+}
+
 schar()
 {
 
@@ -15,7 +15,7 @@ pipe()
 {
 	register *ip, *rf, *wf;
 
-	ip = ialloc(rootdev);
+	ip = ialloc(rootdev, 0);
 	if(ip == NULL)
 		return;
 	wf = falloc();
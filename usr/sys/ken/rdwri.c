@@ -14,7 +14,7 @@ readi(aip)
 struct inode *aip;
 {
 	int *bp;
-	int lbn, bn, on;
+	int lbn, bn, on, nc;
 	register dn, n;
 	register struct inode *ip;
 
@@ -40,14 +40,19 @@ struct inode *aip;
 			if ((bn = bmap(ip, lbn)) == 0)
 				return;
 			dn = ip->i_dev;
+			nc = 1;
+			if (!incore(dn, bn) && bclok(dn))
+				nc = crun(ip, lbn, bn,
+				    min(NCLUST, ldiv(u.u_count, 512)+1));
 		} else {
 			dn = ip->i_addr[0];
-			rablock = bn+1;
+			nc = 1;
 		}
-		if (ip->i_lastr+1 == lbn)
-			bp = breada(dn, bn, rablock);
+		if (nc > 1)
+			bp = bclread(dn, bn, nc);
 		else
 			bp = bread(dn, bn);
+		rahead(ip, lbn, dn);
 		ip->i_lastr = lbn;
 		iomove(bp, on, n, B_READ);
 		brelse(bp);
@@ -58,7 +63,7 @@ writei(aip)
 struct inode *aip;
 {
 	int *bp;
-	int n, on;
+	int n, on, lbn;
 	register dn, bn;
 	register struct inode *ip;
 
@@ -72,11 +77,11 @@ struct inode *aip;
 		return;
 
 	do {
-		bn = lshift(u.u_offset, -9);
+		lbn = bn = lshift(u.u_offset, -9);
 		on = u.u_offset[1] & 0777;
 		n = min(512-on, u.u_count);
 		if((ip->i_mode&IFMT) != IFBLK) {
-			if ((bn = bmap(ip, bn)) == 0)
+			if ((bn = bmap(ip, lbn)) == 0)
 				return;
 			dn = ip->i_dev;
 		} else
@@ -86,10 +91,16 @@ struct inode *aip;
 			bp = bread(dn, bn);
 		iomove(bp, on, n, B_WRITE);
 		if(u.u_error != 0)
-			brelse(bp); else
-		if ((u.u_offset[1]&0777)==0)
-			bawrite(bp); else
+			brelse(bp); else {
 			bdwrite(bp);
+			/*
+			 * full blocks are held back and
+			 * pushed out a cluster at a time
+			 */
+			if ((u.u_offset[1]&0777)==0 &&
+			    (lbn&(NCLUST-1)) == NCLUST-1)
+				bclwrite(dn, bn);
+		}
 		if(dpcmp(ip->i_size0, ip->i_size1,
 		  u.u_offset[0], u.u_offset[1]) < 0 &&
 		  (ip->i_mode&(IFBLK&IFCHR)) == 0) {
@@ -100,6 +111,65 @@ struct inode *aip;
 	} while(u.u_error==0 && u.u_count!=0);
 }
 
+/*
+ * Read-ahead.
+ * The window of blocks read ahead of a
+ * file doubles, up to NRAHEAD, each time
+ * a read follows on from the last one,
+ * and halves when a read jumps elsewhere.
+ * Blocks in the window that have not yet
+ * been asked for are started; the window
+ * stops at a hole, which is not filled.
+ */
+rahead(ip, lbn, dev)
+struct inode *ip;
+{
+	register struct inode *rp;
+	register b, n;
+
+	rp = ip;
+	if(rp->i_lastr+1 == lbn) {
+		n = rp->i_rawin;
+		rp->i_rawin = n? min(n<<1, NRAHEAD): 1;
+	} else
+	if(rp->i_lastr != lbn) {
+		rp->i_rawin =>> 1;
+		rp->i_ranext = 0;
+	}
+	for(b = max(lbn+1, rp->i_ranext); b <= lbn+rp->i_rawin; b++) {
+		n = b;
+		if((rp->i_mode&IFMT) != IFBLK) {
+			if(dpcmp(rp->i_size0, rp->i_size1, b>>7, b<<9) <= 0)
+				break;
+			if((n = bmapr(rp, b)) == 0)
+				break;
+		}
+		rastart(dev, n);
+	}
+	rp->i_ranext = b;
+}
+
+/*
+ * Count the blocks from lbn on that
+ * lie within the file and follow bn
+ * contiguously on the device, up to n.
+ * A hole ends the run.
+ */
+crun(ip, lbn, bn, n)
+struct inode *ip;
+{
+	register i, b;
+
+	for(i=1; i<n; i++) {
+		b = lbn+i;
+		if(dpcmp(ip->i_size0, ip->i_size1, b>>7, b<<9) <= 0)
+			break;
+		if(bmapr(ip, b) != bn+i)
+			break;
+	}
+	return(i);
+}
+
 max(a, b)
 char *a, *b;
 {
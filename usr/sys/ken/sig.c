@@ -29,8 +29,9 @@ int *p;
 	rp = p;
 	rp->p_sig = sig;
 	if(rp->p_stat == SWAIT) {
-		rp->p_wchan = 0;
+		unsleep(rp);
 		rp->p_stat = SRUN;
+		setrq(rp);
 		if(runout) {
 			runout = 0;
 			wakeup(&runout);
@@ -22,6 +22,8 @@ struct ps_word { int integ; };
 
 // Forward declarations for functions called from this file or defined elsewhere
 void wakeup(int chan);
+void unsleep(struct proc *p);
+void setrq(struct proc *p);
 void swtch(void);
 void sched(void);
 int issig(void);
@@ -32,7 +34,11 @@ int *kernel_malloc(int *map, int size_clicks);
 void mfree(int *map, int size, int addr); /* From malloc.c, for coremap/swapmap */
 void clearseg(int seg_addr_clicks); /* Likely assembly, clears a memory click */
 int swap(int swap_addr_blocks, int core_addr_clicks, int count_clicks, int rwflag);
+struct buf *swstart(int swap_addr_blocks, int core_addr_clicks, int count_clicks, int rwflag);
+int swwait(struct buf *bp);
 void xswap(struct proc *p, int write_to_swap_flag, int old_size_clicks_unused);
+struct buf *xswout(struct proc *p, int old_size_clicks);
+void xswdone(struct buf *bp, struct proc *p, int write_to_swap_flag, int old_size_clicks);
 void panic(const char *s);
 int savu(int *savearea); /* Behaves like setjmp for fork, returns 0 in child */
 void retu(int uarea_base_clicks);
@@ -42,6 +48,17 @@ void copyseg(int from_click_addr, int to_click_addr);
 void expand(int newsize_clicks_total_image); /* Defined later in this file */
 int newproc(void); /* Defined later in this file */
 
+/**
+ * @brief Number of sleep queues (must be a power of 2).
+ *
+ * A sleeping process is linked through p_slink on the queue its
+ * channel hashes to, so wakeup() looks only at processes that may
+ * be sleeping on that channel.
+ */
+#define NSQHASH	64
+#define SQHASH(chan)	(&slpque[((chan) ^ ((chan)>>6)) & (NSQHASH-1)])
+
+static struct proc *slpque[NSQHASH];
 
 /**
  * @brief Put the current process to sleep on an event channel.
@@ -60,7 +77,10 @@ void sleep(int chan, int pri)
 	if(pri >= 0) {
 		if(issig())
 			goto psig;
+		spl6();
 		rp->p_wchan = chan;
+		rp->p_slink = *SQHASH(chan);
+		*SQHASH(chan) = rp;
 		rp->p_stat = SWAIT;
 		rp->p_pri = (char)pri;
 		spl0();
@@ -75,7 +95,10 @@ void sleep(int chan, int pri)
 			return;
 		}
 	} else {
+		spl6();
 		rp->p_wchan = chan;
+		rp->p_slink = *SQHASH(chan);
+		*SQHASH(chan) = rp;
 		rp->p_stat = SSLEEP;
 		rp->p_pri = (char)pri;
 		spl0();
@@ -90,56 +113,235 @@ void sleep(int chan, int pri)
  */
 void wakeup(int chan)
 {
-	register struct proc *p;
-	register int n_awakened_swapped_out, c_chan;
+	register struct proc *p, **pp;
+	register int n_awakened_swapped_out;
+	int s_ps;
 
+	s_ps = PS->integ;
+	spl6();
 loop:
-	c_chan = chan;
+	wkstat.wk_call++;
 	n_awakened_swapped_out = 0;
-	for(p = &proc[0]; p < &proc[NPROC]; p++)
-		if(p->p_stat != 0 && p->p_wchan == c_chan) {
-			if(runout!=0 && (p->p_flag&SLOAD)==0) {
-				runout = 0;
-				n_awakened_swapped_out++;
-			}
-			p->p_wchan = 0;
-			p->p_stat = SRUN;
-			runrun = 1;
+	pp = SQHASH(chan);
+	while((p = *pp) != NULL) {
+		wkstat.wk_scan++;
+		if(p->p_wchan != chan) {
+			pp = &p->p_slink;
+			continue;
+		}
+		*pp = p->p_slink;
+		wkstat.wk_wake++;
+		if(runout!=0 && (p->p_flag&SLOAD)==0) {
+			runout = 0;
+			n_awakened_swapped_out++;
 		}
+		p->p_wchan = 0;
+		p->p_stat = SRUN;
+		setrq(p);
+		runrun = 1;
+	}
 	if(n_awakened_swapped_out) {
 		chan = (int)(long)(char *)&runout;
 		goto loop;
 	}
+	PS->integ = s_ps;
+}
+
+/**
+ * @brief Take a sleeping process off its sleep queue without waking it.
+ *
+ * Used when a sleep is cut short, as psignal() does for SWAIT.
+ * @param p The process.
+ */
+void unsleep(struct proc *p)
+{
+	register struct proc **pp;
+	register int s_ps;
+
+	s_ps = PS->integ;
+	spl6();
+	if(p->p_wchan != 0) {
+		for(pp = SQHASH(p->p_wchan); *pp != NULL; pp = &(*pp)->p_slink)
+			if(*pp == p) {
+				*pp = p->p_slink;
+				break;
+			}
+		p->p_wchan = 0;
+	}
+	PS->integ = s_ps;
+}
+
+/**
+ * @brief Number of run queues.
+ *
+ * Priorities -128..127 fall into NRQ bands of 256/NRQ each; swtch()
+ * runs the first process of the lowest non-empty band, and a band is
+ * served first in, first out.
+ */
+#define NRQ	32
+#define RQBAND(pri)	(((pri)+128) >> 3)
+
+static struct proc *rqhead[NRQ];	/**< First process of each band. */
+static struct proc *rqtail[NRQ];	/**< Last process of each band. */
+static int rqmap[NRQ/16];		/**< Bit per band, set while the band is not empty. */
+
+/**
+ * @brief Put a runnable process at the tail of its priority band.
+ *
+ * Called wherever a process becomes SRUN or is brought into core.
+ * A process already queued is left where it is.  Entries that stop
+ * being runnable and loaded are not removed here; swtch() drops them
+ * when it reaches them, and they are queued again by whoever makes
+ * them runnable (wakeup, psignal) or loads them (sched).
+ * @param p The process.
+ */
+void setrq(struct proc *p)
+{
+	register int b, s_ps;
+
+	s_ps = PS->integ;
+	spl6();
+	if((p->p_flag & SRQ) == 0) {
+		b = RQBAND(p->p_pri);
+		p->p_link = NULL;
+		if(rqhead[b] == NULL)
+			rqhead[b] = p;
+		else
+			rqtail[b]->p_link = p;
+		rqtail[b] = p;
+		rqmap[b>>4] |= 1 << (b&017);
+		p->p_flag |= SRQ;
+	}
+	PS->integ = s_ps;
+}
+
+/**
+ * @brief Take the next process to run off the run queues.
+ *
+ * Called at spl6.  Queued processes that are no longer runnable and
+ * in core are dropped on the way.
+ * @return The process, or NULL if none is ready.
+ */
+static struct proc *remrq(void)
+{
+	register struct proc *p;
+	register int b, w;
+
+	for(;;) {
+		for(w = 0; w < NRQ/16 && rqmap[w] == 0; w++)
+			;
+		if(w == NRQ/16)
+			return(NULL);
+		for(b = 0; (rqmap[w] & (1<<b)) == 0; b++)
+			;
+		b += w << 4;
+		p = rqhead[b];
+		if((rqhead[b] = p->p_link) == NULL)
+			rqmap[w] &= ~(1 << (b&017));
+		p->p_flag &= ~SRQ;
+		if(p->p_stat == SRUN && (p->p_flag & SLOAD) != 0)
+			return(p);
+	}
+}
+
+/** @brief Most swap-outs sched() keeps in flight; the other swap buffers are left for swap-ins. */
+#define NSWOUT	(NSWBUF-2)
+
+/** @brief Swap-outs started by sched() and not yet finished, oldest first. */
+static struct swout {
+	struct proc *so_proc;	/**< Process being written out (SLOCK until finished). */
+	struct buf *so_bp;	/**< Swap buffer returned by xswout(). */
+} swout[NSWOUT];
+static int nswout;		/**< Number of entries in use in swout[]. */
+
+/**
+ * @brief Finish the swap-outs started by sched() whose writes are done.
+ * @param wait If nonzero, first wait for the oldest one to complete.
+ */
+static void swreap(int wait)
+{
+	register int i, j;
+
+	i = 0;
+	while(i < nswout) {
+		if(!wait && (swout[i].so_bp->b_flags&B_DONE) == 0) {
+			i++;
+			continue;
+		}
+		wait = 0;
+		xswdone(swout[i].so_bp, swout[i].so_proc, 1, 0);
+		nswout--;
+		for(j = i; j < nswout; j++)
+			swout[j] = swout[j+1];
+	}
+}
+
+/**
+ * @brief Seconds since a process was last swapped in or out, at most 127.
+ *
+ * Worked out from p_swtime when sched() needs it, rather than kept
+ * by clock() counting up every process once a second.
+ * @param p The process.
+ * @return The age in seconds, 0 to 127.
+ */
+static int ptime(struct proc *p)
+{
+	register unsigned int t;
+
+	if(time[0] == p->p_swtime[0])
+		t = (unsigned int)time[1] - (unsigned int)p->p_swtime[1];
+	else if(time[0] == p->p_swtime[0]+1 &&
+	    (unsigned int)time[1] < (unsigned int)p->p_swtime[1])
+		t = (unsigned int)time[1] - (unsigned int)p->p_swtime[1];
+	else
+		t = 127;
+	return(t > 127 ? 127 : t);
 }
 
 /**
  * @brief Main scheduler loop (swapper). Runs as proc[0].
+ *
+ * Swap-outs are started without waiting, up to NSWOUT at a time, and
+ * finished as their writes complete; a swap-in queues the text and data
+ * reads together. The swap device's queue sees several transfers at once.
  */
 void sched()
 {
 	struct proc *p1_candidate_toswapin = NULL;
 	register struct proc *rp;
-	register int a_needed_core_clicks, current_max_time_out;
+	register int a_needed_core_clicks, current_max_time_out, n;
 	int core_address_clicks;
+	struct buf *tbp, *dbp;
 
 sloop:
+	if(nswout) {
+		swreap(1);
+		goto loop;
+	}
 	runin = 1;
 	sleep((int)(long)(char *)&runin, PSWP);
 	goto loop;
 
 loop:
+	swreap(0);
 	spl6();
 	current_max_time_out = -1;
 	p1_candidate_toswapin = NULL;
 
 	for(rp = &proc[0]; rp < &proc[NPROC]; rp++) {
-		if(rp->p_stat==SRUN && (rp->p_flag&SLOAD)==0 && rp->p_time > current_max_time_out) {
+		if(rp->p_stat==SRUN && (rp->p_flag&(SLOAD|SLOCK))==0 &&
+		   (n = ptime(rp)) > current_max_time_out) {
 			p1_candidate_toswapin = rp;
-			current_max_time_out = rp->p_time;
+			current_max_time_out = n;
 		}
 	}
 
 	if(current_max_time_out == -1) {
+		if(nswout) {
+			spl0();
+			swreap(1);
+			goto loop;
+		}
 		runout = 1;
 		sleep((int)(long)(char *)&runout, PSWP);
 		goto loop;
@@ -172,9 +374,9 @@ loop:
 	for(rp = &proc[0]; rp < &proc[NPROC]; rp++) {
 		if((rp->p_flag&(SSYS|SLOCK|SLOAD))==SLOAD &&
 		   (rp->p_stat==SRUN || rp->p_stat==SSLEEP) &&
-		    rp->p_time > oldest_loaded_time) {
+		    (n = ptime(rp)) > oldest_loaded_time) {
 			p1_candidate_toswapout = rp;
-			oldest_loaded_time = rp->p_time;
+			oldest_loaded_time = n;
 		}
 	}
 
@@ -188,28 +390,39 @@ loop:
 found_victim_to_swapout:
 	spl0();
 	rp->p_flag &= ~SLOAD;
-	xswap(rp, 1, 0);
+	if(nswout == NSWOUT)
+		swreap(1);
+	swout[nswout].so_proc = rp;
+	swout[nswout].so_bp = xswout(rp, 0);
+	nswout++;
 	goto loop;
 
 found_core_for_swapin:
 	rp = p1_candidate_toswapin;
+	tbp = NULL;
+	if(rp->p_textp != NULL && rp->p_textp->x_ccount == 0)
+		tbp = swstart(rp->p_textp->x_daddr, core_address_clicks, rp->p_textp->x_size, B_READ);
+	dbp = swstart(rp->p_addr, core_address_clicks + (tbp ? rp->p_textp->x_size : 0), rp->p_size, B_READ);
+	if(tbp != NULL && swwait(tbp))
+		goto swaper;
+	if(swwait(dbp))
+		goto swaper;
 	if(rp->p_textp != NULL) {
 		struct text *txtp = rp->p_textp;
-		if(txtp->x_ccount == 0) {
-			if(swap(txtp->x_daddr, core_address_clicks, txtp->x_size, B_READ))
-				goto swaper;
+		/* Only now is the text in core for others to share. */
+		if(tbp != NULL) {
 			txtp->x_caddr = core_address_clicks;
 			core_address_clicks += txtp->x_size;
 		}
 		txtp->x_ccount++;
 	}
-
-	if(swap(rp->p_addr, core_address_clicks, rp->p_size, B_READ))
-		goto swaper;
 	mfree(swapmap, (rp->p_size+7)/8, rp->p_addr);
 	rp->p_addr = core_address_clicks;
 	rp->p_flag |= SLOAD;
-	rp->p_time = 0;
+	rp->p_swtime[0] = time[0];
+	rp->p_swtime[1] = time[1];
+	if(rp->p_stat == SRUN)
+		setrq(rp);
 	goto loop;
 
 swaper:
@@ -218,43 +431,32 @@ swaper:
 
 /**
  * @brief High-level context switch logic.
+ *
+ * A process giving up the processor while still runnable goes to the
+ * tail of its band; the next process comes off the run queues.
  */
 void swtch()
 {
-	static struct proc *p_last_candidate = NULL;
-	register int i, highest_pri;
-	register struct proc *rp_current_search, *rp_chosen_next;
+	register struct proc *rp_chosen_next;
+	register int s_ps;
 
-	if(p_last_candidate == NULL)
-		p_last_candidate = &proc[0];
+	rp_chosen_next = u.u_procp;
+	if(rp_chosen_next->p_stat == SRUN && (rp_chosen_next->p_flag&SLOAD) != 0)
+		setrq(rp_chosen_next);
 
 	savu(u.u_rsav);
 	retu(proc[0].p_addr);
 
+	s_ps = PS->integ;
 loop:
-	rp_current_search = p_last_candidate;
-	rp_chosen_next = NULL;
-	highest_pri = PUSER + 20;
-
-	for(i=0; i<NPROC; i++) {
-		rp_current_search++;
-		if(rp_current_search >= &proc[NPROC])
-			rp_current_search = &proc[0];
-		if(rp_current_search->p_stat==SRUN && (rp_current_search->p_flag&SLOAD)!=0) {
-			if(rp_current_search->p_pri < highest_pri) {
-				rp_chosen_next = rp_current_search;
-				highest_pri = rp_current_search->p_pri;
-			}
-		}
-	}
-
+	spl6();
+	rp_chosen_next = remrq();
 	if(rp_chosen_next == NULL) {
-		p_last_candidate = &proc[0];
 		idle();
 		goto loop;
 	}
+	PS->integ = s_ps;
 
-	p_last_candidate = rp_chosen_next;
 	retu(rp_chosen_next->p_addr);
 	sureg();
 
@@ -296,8 +498,14 @@ found_proc_slot:
 	p_child_proc_entry->p_textp = p_parent_proc_entry->p_textp;
 	p_child_proc_entry->p_pid = ++mpid;
 	p_child_proc_entry->p_ppid = p_parent_proc_entry->p_pid;
-	p_child_proc_entry->p_time = 0;
+	p_child_proc_entry->p_swtime[0] = time[0];
+	p_child_proc_entry->p_swtime[1] = time[1];
 	p_child_proc_entry->p_pri = p_parent_proc_entry->p_pri;
+	p_child_proc_entry->p_pptr = p_parent_proc_entry;
+	p_child_proc_entry->p_child = NULL;
+	p_child_proc_entry->p_sib = p_parent_proc_entry->p_child;
+	p_parent_proc_entry->p_child = p_child_proc_entry;
+	setrq(p_child_proc_entry);
 
 
 	for(user_ofile_p = &u.u_ofile[0]; user_ofile_p < &u.u_ofile[NOFILE];)
@@ -36,7 +36,7 @@ int bn;
 			 * convert small to large
 			 */
 
-			if ((bp = alloc(d)) == NULL)
+			if ((bp = alloc(d, ip->i_addr[7])) == NULL)
 				return(0);
 			bap = bp->b_addr;
 			for(i=0; i<8; i++) {
@@ -49,7 +49,7 @@ int bn;
 			goto large;
 		}
 		nb = ip->i_addr[bn];
-		if(nb == 0 && (bp = alloc(d)) != NULL) {
+		if(nb == 0 && (bp = alloc(d, bn? ip->i_addr[bn-1]+1: 0)) != NULL) {
 			bdwrite(bp);
 			nb = bp->b_blkno;
 			ip->i_addr[bn] = nb;
@@ -67,10 +67,15 @@ int bn;
 	 */
 
     large:
+	if(bn >= ip->i_xlbn && bn < ip->i_xlbn+ip->i_xcnt) {
+		nb = ip->i_xpbn + (bn - ip->i_xlbn);
+		rablock = bn+1 < ip->i_xlbn+ip->i_xcnt? nb+1: 0;
+		return(nb);
+	}
 	i = bn>>8;
 	if((nb=ip->i_addr[i]) == 0) {
 		ip->i_flag =| IUPD;
-		if ((bp = alloc(d)) == NULL)
+		if ((bp = alloc(d, ip->i_xcnt? ip->i_xpbn+ip->i_xcnt: 0)) == NULL)
 			return(0);
 		nb = bp->b_blkno;
 		ip->i_addr[i] = nb;
@@ -78,17 +83,58 @@ int bn;
 		bp = bread(d, nb);
 	bap = bp->b_addr;
 	i = bn & 0377;
-	if((nb=bap[i]) == 0 && (nbp = alloc(d)) != NULL) {
+	if((nb=bap[i]) == 0 &&
+	   (nbp = alloc(d, i? bap[i-1]+1: bp->b_blkno+1)) != NULL) {
 		nb = nbp->b_blkno;
 		bap[i] = nb;
 		bdwrite(nbp);
 		bdwrite(bp);
-	} else
+	} else {
+		/*
+		 * remember the run of consecutive
+		 * blocks that starts here, so the
+		 * blocks after it need not come
+		 * back to the indirect block
+		 */
+		if(nb != 0) {
+			for(d=i; d<255 && bap[d+1]==bap[d]+1; d++)
+				;
+			ip->i_xlbn = bn;
+			ip->i_xpbn = nb;
+			ip->i_xcnt = d-i+1;
+		}
 		brelse(bp);
+	}
 	rablock = bap[i+1];
 	return(nb);
 }
 
+/*
+ * bmap for blocks that are only to be
+ * read ahead: nothing is allocated, and
+ * a hole, or a block past what the file
+ * can hold, gives 0.
+ */
+bmapr(ip, bn)
+struct inode *ip;
+{
+	register *bp, *bap, nb;
+
+	if(bn & ~03777)
+		return(0);
+	if((ip->i_mode&ILARG) == 0)
+		return((bn & ~7)? 0: ip->i_addr[bn]);
+	if(bn >= ip->i_xlbn && bn < ip->i_xlbn+ip->i_xcnt)
+		return(ip->i_xpbn + (bn - ip->i_xlbn));
+	if((nb = ip->i_addr[bn>>8]) == 0)
+		return(0);
+	bp = bread(ip->i_dev, nb);
+	bap = bp->b_addr;
+	nb = bap[bn&0377];
+	brelse(bp);
+	return(nb);
+}
+
 passc(c)
 char c;
 {
@@ -214,62 +214,70 @@ exit()
 		}
 	iput(u.u_cdir);
 	xfree();
-	a = malloc(swapmap, 8);
-	p = getblk(swapdev, a);
-	bcopy(&u, p->b_addr, 256);
-	bwrite(p);
 	q = u.u_procp;
-	mfree(coremap, q->p_size, q->p_addr);
-	q->p_addr = a;
-	q->p_stat = SZOMB;
 
-loop:
-	for(p = &proc[0]; p < &proc[NPROC]; p++)
-	if(q->p_ppid == p->p_pid) {
-		wakeup(&proc[1]);
-		wakeup(p);
-		for(p = &proc[0]; p < &proc[NPROC]; p++)
-		if(q->p_pid == p->p_ppid)
-			p->p_ppid  = 1;
-		swtch();
-		/* no return */
+	/*
+	 * hand the children to init
+	 */
+	if(p = q->p_child) {
+		for(;;) {
+			p->p_ppid = 1;
+			if(p->p_stat != SZOMB)
+				p->p_pptr = &proc[1];
+			if(p->p_sib == NULL)
+				break;
+			p = p->p_sib;
+		}
+		p->p_sib = proc[1].p_child;
+		proc[1].p_child = q->p_child;
+		q->p_child = NULL;
 	}
-	if(q->p_ppid == 1)
-		panic("no init proc");
-	q->p_ppid = 1;
-	goto loop;
+	mfree(coremap, q->p_size, q->p_addr);
+	p = q->p_pptr;
+
+	/*
+	 * leave the status and times
+	 * in the slot for wait
+	 */
+	q->xp_xstat = u.u_arg[0];
+	q->xp_utime = u.u_utime;
+	q->xp_stime = u.u_stime;
+	q->xp_cutime[0] = u.u_cutime[0];
+	q->xp_cutime[1] = u.u_cutime[1];
+	q->xp_cstime[0] = u.u_cstime[0];
+	q->xp_cstime[1] = u.u_cstime[1];
+	q->p_stat = SZOMB;
+	wakeup(&proc[1]);
+	wakeup(p);
+	swtch();
+	/* no return */
 }
 
 wait()
 {
-	register f, *bp;
-	register struct proc *p;
-
-	f = 0;
+	register f;
+	register struct proc *p, **pp;
 
 loop:
-	for(p = &proc[0]; p < &proc[NPROC]; p++)
-	if(p->p_ppid == u.u_procp->p_pid) {
+	f = 0;
+	for(pp = &u.u_procp->p_child; (p = *pp) != NULL; pp = &p->p_sib) {
 		f++;
 		if(p->p_stat == SZOMB) {
+			*pp = p->p_sib;
 			u.u_ar0[R0] = p->p_pid;
-			bp = bread(swapdev, f=p->p_addr);
-			mfree(swapmap, 8, f);
+			u.u_cstime[0] =+ p->xp_cstime[0];
+			dpadd(u.u_cstime, p->xp_cstime[1]);
+			dpadd(u.u_cstime, p->xp_stime);
+			u.u_cutime[0] =+ p->xp_cutime[0];
+			dpadd(u.u_cutime, p->xp_cutime[1]);
+			dpadd(u.u_cutime, p->xp_utime);
+			u.u_ar0[R1] = p->xp_xstat;
 			p->p_stat = NULL;
 			p->p_pid = 0;
 			p->p_ppid = 0;
 			p->p_sig = 0;
 			p->p_ttyp = 0;
 			p->p_flag = 0;
-			p = bp->b_addr;
-			u.u_cstime[0] =+ p->u_cstime[0];
-			dpadd(u.u_cstime, p->u_cstime[1]);
-			dpadd(u.u_cstime, p->u_stime);
-			u.u_cutime[0] =+ p->u_cutime[0];
-			dpadd(u.u_cutime, p->u_cutime[1]);
-			dpadd(u.u_cutime, p->u_utime);
-			u.u_ar0[R1] = p->u_arg[0];
-			brelse(bp);
 			return;
 		}
 	}
@@ -70,7 +70,7 @@ dup()
 
 smount()
 {
-	int d;
+	int d, i;
 	register *ip;
 	register struct mount *mp, *smp;
 	extern uchar;
@@ -95,6 +95,9 @@ smount()
 	}
 	if(smp == NULL)
 		goto out;
+	(*bdevsw[d.d_major].d_open)(d, !u.u_arg[2]);
+	if(u.u_error)
+		goto out1;
 	mp = bread(d, 1);
 	if(u.u_error) {
 		brelse(mp);
@@ -102,6 +105,9 @@ smount()
 	}
 	smp->m_inodp = ip;
 	smp->m_dev = d;
+	smp->m_irotor = 0;
+	for(i=0; i<NIMAP; i++)
+		smp->m_imap[i] = 0;
 	smp->m_bufp = getblk(NODEV);
 	bcopy(mp->b_addr, smp->m_bufp->b_addr, 256);
 	smp = smp->m_bufp->b_addr;
@@ -141,6 +147,7 @@ found:
 			u.u_error = EBUSY;
 			return;
 		}
+	ncinval(d, 0);
 	ip = mp->m_inodp;
 	ip->i_flag =& ~IMOUNT;
 	iput(ip);
@@ -118,6 +118,8 @@ unlink()
 	u.u_count = DIRSIZ+2;
 	u.u_dent.u_ino = 0;
 	writei(pp);
+	dhdel(pp);
+	ncenter(pp, 0);
 	ip->i_nlink--;
 	ip->i_flag =| IUPD;
 
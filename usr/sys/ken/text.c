@@ -9,9 +9,23 @@
 #include "../proc.h"
 #include "../text.h"
 #include "../inode.h"
+#include "../buf.h"
 
 xswap(p, ff, os)
 int *p;
+{
+
+	xswdone(xswout(p, os), p, ff, os);
+}
+
+/*
+ * Give process p swap space and start
+ * writing out the first os clicks of its
+ * image.  The process stays SLOCK until
+ * xswdone is called on the returned buffer.
+ */
+xswout(p, os)
+int *p;
 {
 	register *rp, a;
 
@@ -23,13 +37,31 @@ int *p;
 		panic("out of swap space");
 	xccdec(rp->p_textp);
 	rp->p_flag =| SLOCK;
-	if(swap(a, rp->p_addr, os, 0))
+	return(swstart(a, rp->p_addr, os, 0));
+}
+
+/*
+ * Wait for the write begun by xswout,
+ * free the core if ff is set and mark
+ * the process swapped out.
+ */
+xswdone(bp, p, ff, os)
+int *bp, *p;
+{
+	register *rp, a;
+
+	rp = p;
+	if(os == 0)
+		os = rp->p_size;
+	a = bp->b_blkno;
+	if(swwait(bp))
 		panic("swap error");
 	if(ff)
 		mfree(coremap, os, rp->p_addr);
 	rp->p_addr = a;
 	rp->p_flag =& ~(SLOAD|SLOCK);
-	rp->p_time = 0;
+	rp->p_swtime[0] = time[0];
+	rp->p_swtime[1] = time[1];
 	if(runout) {
 		runout = 0;
 		wakeup(&runout);
@@ -8,10 +8,19 @@
 
 /** @name System table sizes and limits */
 ///@{
-#define	NBUF	15		/**< Number of system buffers in the buffer cache. */
+#define	MAXBUF	20		/**< Buffers in the statically reserved arena; nbuf can only lower this. */
+#define	NHBUF	64		/**< Number of buffer hash chains (must be a power of 2). */
+#define	NCLUST	8		/**< Most blocks moved by one clustered transfer (must be a power of 2). */
+#define	NRAHEAD	8		/**< Largest read-ahead window, in blocks. */
+#define	NSWBUF	4		/**< Number of swap buffers; swap transfers in flight at once. */
 #define	NINODE	100		/**< Number of in-core inodes. */
+#define	NIHASH	32		/**< Number of in-core inode hash chains (must be a power of 2). */
+#define	NNCACHE	64		/**< Number of directory name cache entries. */
+#define	DHBASE	1792	/**< Logical block of a large directory's hashed index header. */
+#define	NDHB	32		/**< Number of hashed index bucket blocks (must be a power of 2). */
 #define	NFILE	100		/**< Number of entries in the system open file table. */
 #define	NMOUNT	5		/**< Maximum number of mounted file systems. */
+#define	NIMAP	32		/**< Bytes of full-inode-block map kept per mount; covers NIMAP*8 inode blocks. */
 #define	NEXEC	4		/**< Maximum number of concurrent execs (?). */
 #define	MAXMEM	(32*32)		/**< Maximum core memory size in 64-byte clicks (32K words = 64K bytes). */
 #define	SSIZE	20		/**< Initial stack size in 64-byte clicks for user processes. */
@@ -20,7 +29,8 @@
 #define	CANBSIZ	256		/**< Size of canonical input buffer (for TTYs). */
 #define	CMAPSIZ	100		/**< Size of the coremap (physical memory allocation map). */
 #define	SMAPSIZ	100		/**< Size of the swapmap (swap space allocation map). */
-#define	NCALL	20		/**< Number of entries in the callout table (for timed events). */
+#define	NCALL	50		/**< Number of entries in the callout table (for timed events). */
+#define	NCWHEEL	64		/**< Number of slots in the callout wheel (must be a power of 2). */
 #define	NPROC	50		/**< Maximum number of processes. */
 #define	NTEXT	20		/**< Maximum number of active shared text segments. */
 #define	NCLIST	100		/**< Number of clist blocks (for TTY character buffering). */
@@ -19,7 +19,6 @@ struct proc {
 	char	p_pri;		/**< Process priority; lower is higher. Used for scheduling. */
 	char	p_sig;		/**< Lowest numbered signal pending for this process. */
 	char	p_uid;		/**< User ID of the process. */
-	char	p_time;		/**< Resident time for scheduling (aging). */
 	int	p_ttyp;		/**< Controlling TTY pointer (e.g., to an entry in a TTY structure array) or device number. */
 	int	p_pid;		/**< Process ID. */
 	int	p_ppid;		/**< Parent process ID. */
@@ -27,8 +26,52 @@ struct proc {
 	int	p_size;		/**< Size of process image (U-area + data + stack) in 64-byte clicks. */
 	int	p_wchan;	/**< Event address on which process is sleeping (or 0 if not sleeping). */
 	struct text *p_textp;	/**< Pointer to shared text segment structure (if any). */
+	struct proc *p_link;	/**< Next process on the same run queue (while SRQ is set). */
+	struct proc *p_slink;	/**< Next process on the same sleep queue (while p_wchan is set). */
+	struct proc *p_pptr;	/**< Parent process. */
+	struct proc *p_child;	/**< First child, most recently created first. */
+	struct proc *p_sib;	/**< Next child of the same parent. */
+	int	p_swtime[2];	/**< time when last swapped in or out; sched() ages the process from it. */
 } proc[NPROC];			/**< The process table array. @see NPROC in param.h */
 
+/**
+ * @struct xproc
+ * @brief A zombie's proc entry.
+ *
+ * exit() leaves the exit status and times in the zombie's own slot,
+ * laid over p_addr through p_child, so wait() does not need the
+ * u-area.  Those fields, p_pptr and p_child among them, must not be
+ * stored into once the process is SZOMB.  p_sib is kept, as the
+ * zombie stays on its parent's list of children until it is waited for.
+ */
+struct xproc {
+	char	xp_stat;
+	char	xp_flag;
+	char	xp_pri;
+	char	xp_sig;
+	char	xp_uid;
+	int	xp_ttyp;
+	int	xp_pid;
+	int	xp_ppid;
+	int	xp_xstat;	/**< Exit status, as wait() returns it in r1 (over p_addr). */
+	int	xp_utime;	/**< User time of the process. */
+	int	xp_stime;	/**< System time of the process. */
+	int	xp_cutime[2];	/**< User time of its children. */
+	int	xp_cstime[2];	/**< System time of its children; [1] lies over p_pptr. */
+	int	xp_pad;		/**< Lies over p_child. */
+	struct proc *xp_sib;	/**< Same as p_sib. */
+};
+
+/**
+ * @struct wkstat
+ * @brief wakeup() statistics, counted by slp.c.
+ */
+struct wkstat {
+	int	wk_call;	/**< Calls to wakeup(). */
+	int	wk_scan;	/**< Sleeping processes examined by wakeup(). */
+	int	wk_wake;	/**< Processes made runnable by wakeup(). */
+} wkstat;
+
 /** @name Process status codes (p_stat) */
 ///@{
 #define	SSLEEP	1		/**< Sleeping on an event usually interruptible by signals. */
@@ -44,4 +87,5 @@ struct proc {
 #define	SSYS	02		/**< System process (e.g., swapper, init); cannot be killed by normal signals. */
 #define	SLOCK	04		/**< Process is locked in core (cannot be swapped out). */
 #define	SSWAP	010		/**< Process is currently being swapped out (image is not valid in core). */
+#define	SRQ	020		/**< Process is on a run queue. */
 ///@}
@@ -23,12 +23,17 @@ extern int	tout[2];			/**< Time of next callout event. */
 /**
  * @struct callo
  * @brief Structure for the callout table, used for scheduling functions to be called after a timeout.
+ *
+ * A pending entry hangs on the slot of the callout wheel in which it
+ * falls due; free entries are chained through c_next.
  */
 struct	callo
 {
-	int	c_time;				/**< Time (in lbolt ticks) at which function should be called. */
+	int	c_time;				/**< Turns of the wheel still to pass before the entry is due. */
 	int	c_arg;				/**< Argument to be passed to the function. */
-	int	(*c_func)();		/**< Pointer to the function to be called. */
+	int	(*c_func)();		/**< Pointer to the function to be called; 0 if the entry is free. */
+	struct callo *c_next;	/**< Next entry in the same wheel slot, or on the free list. */
+	struct callo **c_back;	/**< Pointer that points at this entry, for unlinking. */
 } callout[NCALL];				/**< The callout table itself. */
 
 /**
@@ -40,6 +45,8 @@ struct	mount
 	int	m_dev;				/**< Device number of the mounted file system. */
 	struct buf *m_bufp;		/**< Pointer to the buffer containing the superblock of this fs. */
 	struct inode *m_inodp;	/**< Pointer to the in-core inode of the directory on which this fs is mounted. */
+	int	m_irotor;			/**< Inode block at which ialloc's next refill scan starts. */
+	char	m_imap[NIMAP];	/**< Bit per inode block, set when the block is known to hold no free inode. */
 } mount[NMOUNT];				/**< The mount table itself. */
 
 extern int	mpid;				/**< Last process ID assigned. */